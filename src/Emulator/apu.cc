@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <exception>
 #include <cstring>
 #include <cmath>
@@ -17,6 +18,19 @@ T clamp(T val, T low, T hi)
     return (val < low) ? low : ((val > hi) ? hi : val);
 }
 
+// Look up a fractional index by interpolating between entries, scaling the channel
+// levels by their volumes leaves the index between two of them
+float lookup(const float* table, uint32_t size, float index)
+{
+    uint32_t i = static_cast<uint32_t>(index);
+    if (i >= size - 1)
+    {
+        return table[size - 1];
+    }
+
+    return table[i] + (table[i + 1] - table[i]) * (index - static_cast<float>(i));
+}
+
 };
 
 const uint8_t APU::LengthCounterLookupTable[32] =
@@ -861,88 +875,146 @@ void APU::DmcUnit::LoadState(const StateSave::Ptr& state)
 // APU Mixer
 //**********************************************************************
 
+float APU::MixerUnit::PulseTable[APU::MixerUnit::PULSE_TABLE_SIZE];
+float APU::MixerUnit::TndTable[APU::MixerUnit::TND_TABLE_SIZE];
+
+bool APU::MixerUnit::BuildTables()
+{
+	PulseTable[0] = 0.0f;
+	for (uint32_t i = 1; i < PULSE_TABLE_SIZE; ++i)
+	{
+		PulseTable[i] = 95.52f / ((8128.0f / i) + 100.0f);
+	}
+
+	TndTable[0] = 0.0f;
+	for (uint32_t i = 1; i < TND_TABLE_SIZE; ++i)
+	{
+		TndTable[i] = 163.67f / ((24329.0f / i) + 100.0f);
+	}
+
+	return true;
+}
+
 APU::MixerUnit::MixerUnit(APU& apu)
 	: Apu(apu)
 	, TurboModeEnabled(false)
+	, MaxSpeedModeEnabled(false)
 	, AudioEnabled(true)
-	, PulseOneAccumulator(0)
-	, PulseTwoAccumulator(0)
-	, TriangleAccumulator(0)
-	, NoiseAccumulator(0)
-	, DmcAccumulator(0)
-	, CyclesPerSample(0)
-	, CycleRemainder(0)
-	, CycleCount(0)
-	, ExtraCycle(0)
-	, ExtraCount(0)
-	, TargetFramePeriod(0)
+	, DynamicRateControlEnabled(false)
+	, BufferFill(0.5f)
+	, Levels(0)
+	, Amplitude(0.0f)
+	, BlockCycle(0)
+	, CyclesPerBlock(0)
 	, TargetCpuFrequency(0)
-	, SamplesPerFrame(0)
-	, FrameSampleCount(0)
+	, StemPhase(0)
 {
+	static const bool tablesBuilt = BuildTables();
+	(void)tablesBuilt;
+
 	SetTargetFrameRate(60);
 }
 
 void APU::MixerUnit::Clock()
 {
-	PulseOneAccumulator += Apu.PulseOne.GetLevel();
-	PulseTwoAccumulator += Apu.PulseTwo.GetLevel();
-	TriangleAccumulator += Apu.Triangle.GetLevel();
-	NoiseAccumulator += Apu.Noise.GetLevel();
-	DmcAccumulator += Apu.Dmc.GetLevel();
-
-	CycleCount++;
-
-	if (CycleCount == CyclesPerSample)
+	if (AudioEnabled && !MaxSpeedModeEnabled)
 	{
-		ExtraCount += CycleRemainder;
+		uint32_t levels = Apu.PulseOne.GetLevel()
+			| (Apu.PulseTwo.GetLevel() << 5)
+			| (Apu.Triangle.GetLevel() << 10)
+			| (Apu.Noise.GetLevel() << 15)
+			| (Apu.Dmc.GetLevel() << 20);
 
-		if (ExtraCount > Apu.AudioOut->GetSampleRate())
-		{
-			ExtraCount = ExtraCount - Apu.AudioOut->GetSampleRate();
-		}
-		else
+		if (levels != Levels)
 		{
-			if (AudioEnabled && !TurboModeEnabled)
-			{
-				GenerateSample();
-			}
-
-			CycleCount = 0;
-
-			FrameSampleCount++;
-			if (FrameSampleCount >= SamplesPerFrame)
-			{
-				UpdateMode();
-				FrameSampleCount = 0;
-			}
+			Levels = levels;
+
+			float amplitude = GetAmplitude();
+			Synth.AddDelta(BlockCycle, amplitude - Amplitude);
+			Amplitude = amplitude;
 		}
 	}
-	else if (CycleCount > CyclesPerSample)
+
+	if (Stems != nullptr)
+	{
+		RecordStems();
+	}
+
+	if (++BlockCycle == CyclesPerBlock)
+	{
+		EndBlock();
+	}
+}
+
+void APU::MixerUnit::RecordStems()
+{
+	StemPhase += STEM_SAMPLE_RATE;
+	if (StemPhase >= CPU::NTSC_FREQUENCY)
+	{
+		StemPhase -= CPU::NTSC_FREQUENCY;
+
+		// Taken straight from the channels, so muting and the speed modes don't affect them
+		Stems->Record(Apu.PulseOne.GetLevel(), Apu.PulseTwo.GetLevel(), Apu.Triangle.GetLevel(), Apu.Noise.GetLevel(), Apu.Dmc.GetLevel());
+	}
+}
+
+void APU::MixerUnit::StartStemCapture(const std::string& pathPrefix)
+{
+	StopStemCapture();
+
+	Stems.reset(new StemRecorder(pathPrefix, STEM_SAMPLE_RATE));
+	StemPhase = 0;
+}
+
+void APU::MixerUnit::StopStemCapture()
+{
+	if (Stems != nullptr)
+	{
+		Stems->Finish();
+		Stems.reset();
+	}
+}
+
+void APU::MixerUnit::EndBlock()
+{
+	if (AudioEnabled && !MaxSpeedModeEnabled)
 	{
-		if (AudioEnabled && !TurboModeEnabled)
+		// Volumes can change while the channels are silent, pick that up here
+		float amplitude = GetAmplitude();
+		if (amplitude != Amplitude)
 		{
-			GenerateSample();
+			Synth.AddDelta(BlockCycle, amplitude - Amplitude);
+			Amplitude = amplitude;
 		}
 
-		CycleCount = 0;
+		Synth.EndBlock(BlockCycle);
+		Synth.SetLevel(Amplitude);
+
+		uint32_t count = Synth.ReadSamples(Samples.data(), static_cast<uint32_t>(Samples.size()));
+		Filter.Process(Samples.data(), count);
+		Output.Process(Samples.data(), count, Resampled);
 
-		FrameSampleCount++;
-		if (FrameSampleCount >= SamplesPerFrame)
+		Apu.AudioOut->SubmitSamples(Resampled.data(), static_cast<uint32_t>(Resampled.size()));
+
+		// The time stretcher paces fast forward audio itself
+		if (DynamicRateControlEnabled && !TurboModeEnabled)
 		{
-			UpdateMode();
-			FrameSampleCount = 0;
+			UpdateRateAdjustment();
 		}
 	}
+
+	BlockCycle = 0;
+
+	UpdateMode();
 }
 
-void APU::MixerUnit::GenerateSample()
+float APU::MixerUnit::GetAmplitude()
 {
-	float pulseOneLevel = static_cast<float>(PulseOneAccumulator) / CycleCount;
-	float pulseTwoLevel = static_cast<float>(PulseTwoAccumulator) / CycleCount;
-	float triangleLevel = static_cast<float>(TriangleAccumulator) / CycleCount;
-	float noiseLevel = static_cast<float>(NoiseAccumulator) / CycleCount;
-	float dmcLevel = static_cast<float>(DmcAccumulator) / CycleCount;
+	float pulseOneLevel = static_cast<float>(Levels & 0x1F);
+	float pulseTwoLevel = static_cast<float>((Levels >> 5) & 0x1F);
+	float triangleLevel = static_cast<float>((Levels >> 10) & 0x1F);
+	float noiseLevel = static_cast<float>((Levels >> 15) & 0x1F);
+	float dmcLevel = static_cast<float>(Levels >> 20);
 
 	pulseOneLevel *= Apu.PulseOneVolume;
 	pulseTwoLevel *= Apu.PulseTwoVolume;
@@ -950,40 +1022,25 @@ void APU::MixerUnit::GenerateSample()
 	noiseLevel *= Apu.NoiseVolume;
 	dmcLevel *= Apu.DmcVolume;
 
-	PulseOneAccumulator = 0;
-	PulseTwoAccumulator = 0;
-	TriangleAccumulator = 0;
-	NoiseAccumulator = 0;
-	DmcAccumulator = 0;
-
-	float pulse = 0.0f;
-	float tndOut = 0.0f;
-
-	if (pulseOneLevel != 0.0f || pulseTwoLevel != 0.0f)
-	{
-		pulse = 95.88f / ((8128.0f / (pulseOneLevel + pulseTwoLevel)) + 100.0f);
-	}
-
-	if (triangleLevel != 0.0f || noiseLevel != 0.0f || dmcLevel != 0.0f)
-	{
-		tndOut = 159.79f / ((1.0f / ((triangleLevel / 8227.0f) + (noiseLevel / 12241.0f) + (dmcLevel / 22638.0f))) + 100.0f);
-	}
+	float pulse = lookup(PulseTable, PULSE_TABLE_SIZE, pulseOneLevel + pulseTwoLevel);
+	float tndOut = lookup(TndTable, TND_TABLE_SIZE, (3.0f * triangleLevel) + (2.0f * noiseLevel) + dmcLevel);
 
-	// Send final sample to the backend
-	float finalSample = (((pulse + tndOut) * Apu.MasterVolume) * 2.0f) - 1.0f;
-	Apu.AudioOut->SubmitSample(finalSample);
+	// No need to centre it on zero, the output filter takes out the DC offset
+	return (pulse + tndOut) * Apu.MasterVolume * 2.0f;
 }
 
 void APU::MixerUnit::Reset()
 {
-	CycleCount = 0;
-	ExtraCount = 0;
-	FrameSampleCount = 0;
-	PulseOneAccumulator = 0;
-	PulseTwoAccumulator = 0;
-	TriangleAccumulator = 0;
-	NoiseAccumulator = 0;
-	DmcAccumulator = 0;
+	BlockCycle = 0;
+
+	// Start from silence, the first cycle mixed will step to the real level. All channels
+	// at zero mixes to 0 whatever the volumes are.
+	Levels = 0;
+	Amplitude = 0.0f;
+	Synth.Clear(Amplitude);
+	Filter.Reset();
+	Output.Reset(0.0f);
+	BufferFill = 0.5f;
 
     Apu.AudioOut->Reset();
 }
@@ -992,44 +1049,96 @@ void APU::MixerUnit::SetTargetFrameRate(uint32_t rate)
 {
 	// Minimum framerate is 20 fps
 	rate = clamp(rate, 20U, 240U);
-	TargetFramePeriod = 1000000 / rate;
 
 	// Special case for 60 fps to avoid any floating point weirdness
 	if (rate == 60)
 	{
 		TargetCpuFrequency = CPU::NTSC_FREQUENCY;
-		CyclesPerSample = CPU::NTSC_FREQUENCY / Apu.AudioOut->GetSampleRate();
-		CycleRemainder = CPU::NTSC_FREQUENCY % Apu.AudioOut->GetSampleRate();
-		SamplesPerFrame = Apu.AudioOut->GetSampleRate() / rate;
 	}
 	else
 	{
 		TargetCpuFrequency = static_cast<uint32_t>(static_cast<double>(CPU::NTSC_FREQUENCY) * (static_cast<double>(rate) / 60.0));
-		CyclesPerSample = TargetCpuFrequency / Apu.AudioOut->GetSampleRate();
-		CycleRemainder = TargetCpuFrequency % Apu.AudioOut->GetSampleRate();
-		SamplesPerFrame = Apu.AudioOut->GetSampleRate() / rate;
 	}
 
+	// Emulating faster than 60 fps runs the CPU faster, so the synth's clock rate goes
+	// up with it to keep the pitch the same
+	CyclesPerBlock = TargetCpuFrequency / (rate * BLOCKS_PER_FRAME);
+
+	Synth.SetRates(TargetCpuFrequency, SYNTH_SAMPLE_RATE, CyclesPerBlock);
+	Filter.SetSampleRate(SYNTH_SAMPLE_RATE);
+	Samples.resize((static_cast<uint64_t>(CyclesPerBlock) * SYNTH_SAMPLE_RATE) / TargetCpuFrequency + 2);
+
+	uint32_t sampleRate = Apu.AudioOut->GetSampleRate();
+	Output.SetRates(SYNTH_SAMPLE_RATE, sampleRate);
+	Resampled.reserve((Samples.size() * sampleRate) / SYNTH_SAMPLE_RATE + 2);
+
 	Reset();
 }
 
+void APU::MixerUnit::UpdateRateAdjustment()
+{
+	AudioStatistics statistics = Apu.AudioOut->GetStatistics();
+	if (statistics.deviceBufferSize == 0)
+	{
+		return;
+	}
+
+	// Anything queued on the way to the device counts too. Aim for half full, which
+	// leaves the same room for timing jitter either way.
+	uint32_t queued = statistics.deviceBufferFill + statistics.queuedSamples;
+	float fill = std::min(static_cast<float>(queued) / statistics.deviceBufferSize, 1.0f);
+	BufferFill += (fill - BufferFill) * RATE_CONTROL_SMOOTHING;
+
+	// Emptier than target makes more samples per input sample and fuller makes fewer
+	Output.SetRatioAdjustment(1.0 + MAX_RATE_ADJUSTMENT * (1.0 - 2.0 * BufferFill));
+}
+
 void APU::MixerUnit::UpdateMode()
 {
-	if (Apu.TurboModeEnabled != TurboModeEnabled)
+	if (Apu.TurboModeEnabled != TurboModeEnabled || Apu.MaxSpeedModeEnabled != MaxSpeedModeEnabled)
 	{
+		bool wasMuted = MaxSpeedModeEnabled;
+
 		TurboModeEnabled = Apu.TurboModeEnabled;
+		MaxSpeedModeEnabled = Apu.MaxSpeedModeEnabled;
+
+		// Only turbo mode gets fast forward audio, max speed mode is muted outright
+		bool fastForward = TurboModeEnabled && !MaxSpeedModeEnabled;
 
-		if (!TurboModeEnabled)
+		// Stop the time stretcher before touching the output again
+		if (!fastForward)
+		{
+			Apu.AudioOut->SetFastForwardEnabled(false);
+		}
+
+		// Start over when mixing comes back after max speed mode, or drops back to
+		// normal speed after turbo mode
+		if (!MaxSpeedModeEnabled && (wasMuted || !TurboModeEnabled))
 		{
 			Reset();
 		}
+
+		if (fastForward)
+		{
+			Apu.AudioOut->SetFastForwardEnabled(true);
+		}
+	}
+
+	if (Apu.DynamicRateControlEnabled != DynamicRateControlEnabled)
+	{
+		DynamicRateControlEnabled = Apu.DynamicRateControlEnabled;
+
+		if (!DynamicRateControlEnabled)
+		{
+			Output.SetRatioAdjustment(1.0);
+		}
 	}
 
 	if (Apu.AudioEnabled != AudioEnabled)
 	{
 		AudioEnabled = Apu.AudioEnabled;
 
-		if (AudioEnabled && !TurboModeEnabled)
+		if (AudioEnabled && !TurboModeEnabled && !MaxSpeedModeEnabled)
 		{
 			Reset();
 		}
@@ -1056,7 +1165,9 @@ APU::APU(AudioBackend* aout)
     , FrameResetFlag(false)
     , FrameResetCountdown(0)
     , TurboModeEnabled(false)
+	, MaxSpeedModeEnabled(false)
 	, AudioEnabled(true)
+	, DynamicRateControlEnabled(false)
     , MasterVolume(1.0f)
     , PulseOneVolume(1.0f)
     , PulseTwoVolume(1.0f)
@@ -1280,6 +1391,26 @@ void APU::SetAudioEnabled(bool enabled)
 	AudioEnabled = enabled;
 }
 
+void APU::SetMaxSpeedModeEnabled(bool enabled)
+{
+	MaxSpeedModeEnabled = enabled;
+}
+
+void APU::SetDynamicRateControlEnabled(bool enabled)
+{
+	DynamicRateControlEnabled = enabled;
+}
+
+void APU::StartStemCapture(const std::string& pathPrefix)
+{
+	Mixer.StartStemCapture(pathPrefix);
+}
+
+void APU::StopStemCapture()
+{
+	Mixer.StopStemCapture();
+}
+
 void APU::SetMasterVolume(float volume)
 {
     MasterVolume = clamp(volume, 0.0f, 1.0f);
@@ -2,8 +2,15 @@
 
 #include <atomic>
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "state_save.h"
+#include "audio/blip_buffer.h"
+#include "audio/resampler.h"
+#include "audio/output_filter.h"
+#include "audio/stem_recorder.h"
 
 class NES;
 class CPU;
@@ -41,6 +48,18 @@ public:
     void SetTurboModeEnabled(bool enabled);
     void SetAudioEnabled(bool mute);
 
+    // Skip mixing entirely while the emulator runs unpaced, see NES::SetMaxSpeedModeEnabled
+    void SetMaxSpeedModeEnabled(bool enabled);
+
+    // Continuously nudge the output sample rate to keep the audio device's buffer half
+    // full, for when something other than the audio device is pacing emulation
+    void SetDynamicRateControlEnabled(bool enabled);
+
+    // Record each channel's output to its own WAV file, see StemRecorder. Only call
+    // these while emulation isn't running.
+    void StartStemCapture(const std::string& pathPrefix);
+    void StopStemCapture();
+
     float GetMasterVolume();
     void SetMasterVolume(float volume);
     void SetPulseOneVolume(float volume);
@@ -222,32 +241,68 @@ private:
 
 		void Clock();
 		void SetTargetFrameRate(uint32_t rate);
+		void StartStemCapture(const std::string& pathPrefix);
+		void StopStemCapture();
 
 	private:
+		// Samples are read out of the synth and sent to the backend this many times a frame
+		static constexpr uint32_t BLOCKS_PER_FRAME = 4;
+
+		// The synth always runs at this rate, the resampler takes it the rest of the way
+		// to whatever rate the device wants
+		static constexpr uint32_t SYNTH_SAMPLE_RATE = 48000;
+
+		// Furthest dynamic rate control will move the output rate from nominal. Small
+		// enough that the change in pitch can't be heard.
+		static constexpr double MAX_RATE_ADJUSTMENT = 0.005;
+
+		// Weight of each new buffer fill reading in the smoothed fill. The device only
+		// drains a period at a time so single readings jump around.
+		static constexpr float RATE_CONTROL_SMOOTHING = 0.05f;
+
 		void Reset();
-		void GenerateSample();
+		void EndBlock();
 		void UpdateMode();
+		void UpdateRateAdjustment();
+		float GetAmplitude();
+		void RecordStems();
+
+		// Output of the non-linear DAC, the pulse table indexed by the sum of the pulse
+		// levels and the TND table by 3 * triangle + 2 * noise + dmc
+		static constexpr uint32_t PULSE_TABLE_SIZE = 31;
+		static constexpr uint32_t TND_TABLE_SIZE = 203;
+		static float PulseTable[PULSE_TABLE_SIZE];
+		static float TndTable[TND_TABLE_SIZE];
+		static bool BuildTables();
 
 		APU& Apu;
 
 		bool TurboModeEnabled;
+		bool MaxSpeedModeEnabled;
 		bool AudioEnabled;
+		bool DynamicRateControlEnabled;
+		float BufferFill; // Smoothed fraction of the device buffer filled
+
+		// Channel levels are only mixed when one of them changes, and the change in the
+		// mixed amplitude is handed to the synth at the cycle it happened on
+		BlipBuffer Synth;
+		uint32_t Levels; // The five channel levels packed 5 bits each, as last mixed
+		float Amplitude;
 
-		uint32_t PulseOneAccumulator;
-		uint32_t PulseTwoAccumulator;
-		uint32_t TriangleAccumulator;
-		uint32_t NoiseAccumulator;
-		uint32_t DmcAccumulator;
-
-		uint32_t CyclesPerSample;
-		uint32_t CycleRemainder;
-		uint32_t CycleCount;
-		uint32_t ExtraCycle;
-		uint32_t ExtraCount;
-		uint32_t TargetFramePeriod;
+		uint32_t BlockCycle;
+		uint32_t CyclesPerBlock;
 		uint32_t TargetCpuFrequency;
-		uint32_t SamplesPerFrame;
-		uint32_t FrameSampleCount;
+		std::vector<float> Samples;
+
+		OutputFilter Filter;
+		Resampler Output;
+		std::vector<float> Resampled;
+
+		// Stems are sampled in emulated time, ticking STEM_SAMPLE_RATE per CPU cycle
+		// and taking a sample each time it passes the CPU frequency
+		static constexpr uint32_t STEM_SAMPLE_RATE = 48000;
+		std::unique_ptr<StemRecorder> Stems;
+		uint32_t StemPhase;
 	};
 
     CPU* Cpu;
@@ -271,7 +326,9 @@ private:
     uint8_t FrameResetCountdown;
 
     std::atomic<bool> TurboModeEnabled;
+	std::atomic<bool> MaxSpeedModeEnabled;
 	std::atomic<bool> AudioEnabled;
+	std::atomic<bool> DynamicRateControlEnabled;
 
     // Volume Controls
     std::atomic<float> MasterVolume;
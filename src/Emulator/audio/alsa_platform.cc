@@ -2,12 +2,12 @@
 
 #include "alsa_platform.h"
 #include "nes_exception.h"
-#include <cstring>
 
-static constexpr uint32_t NUM_PERIODS = 4;
-static constexpr uint32_t STANDARD_FRAME_RATE = 60;
+#include <algorithm>
 
-void AlsaPlatform::Initialize(uint32_t sampleRate)
+static constexpr uint32_t MIN_PERIODS = 2;
+
+void AlsaPlatform::Initialize(uint32_t sampleRate, uint32_t periodLength, uint32_t numPeriods)
 {
     int32_t rc;
     snd_pcm_hw_params_t* alsaHwParams = nullptr;
@@ -16,7 +16,7 @@ void AlsaPlatform::Initialize(uint32_t sampleRate)
 
     _alsaHandle = nullptr;
     _sampleRate = sampleRate;
-    _numOutputBuffers = NUM_PERIODS;
+    numPeriods = std::max(numPeriods, MIN_PERIODS);
 
     rc = snd_pcm_open(&_alsaHandle, "default", SND_PCM_STREAM_PLAYBACK, 0);
     if (rc < 0) goto FailedExit;
@@ -29,8 +29,15 @@ void AlsaPlatform::Initialize(uint32_t sampleRate)
     rc = snd_pcm_hw_params_any(_alsaHandle, alsaHwParams);
     if (rc < 0) goto FailedExit;
 
-    rc = snd_pcm_hw_params_set_access(_alsaHandle, alsaHwParams, SND_PCM_ACCESS_RW_INTERLEAVED);
-    if (rc < 0) goto FailedExit;
+    // Prefer mapping the device's buffer so samples are written into it with no extra
+    // copies, not every device or plugin supports it
+    _mmapEnabled = snd_pcm_hw_params_set_access(_alsaHandle, alsaHwParams, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+
+    if (!_mmapEnabled)
+    {
+        rc = snd_pcm_hw_params_set_access(_alsaHandle, alsaHwParams, SND_PCM_ACCESS_RW_INTERLEAVED);
+        if (rc < 0) goto FailedExit;
+    }
 
     rc = snd_pcm_hw_params_set_format(_alsaHandle, alsaHwParams, SND_PCM_FORMAT_FLOAT);
     if (rc < 0) goto FailedExit;
@@ -41,14 +48,12 @@ void AlsaPlatform::Initialize(uint32_t sampleRate)
     rc = snd_pcm_hw_params_set_channels(_alsaHandle, alsaHwParams, 2);
     if (rc < 0) goto FailedExit;
 
-    // Target period size is a quarter frame
-    periodSize = _sampleRate / STANDARD_FRAME_RATE / NUM_PERIODS;
+    periodSize = std::max((_sampleRate * periodLength) / 1000, 1U);
 
     rc = snd_pcm_hw_params_set_period_size_near(_alsaHandle, alsaHwParams, &periodSize, nullptr);
     if (rc < 0) goto FailedExit;
 
-    // Target buffer size is four periods (a whole frame)
-    bufferSize = periodSize * NUM_PERIODS;
+    bufferSize = periodSize * numPeriods;
 
     rc = snd_pcm_hw_params_set_buffer_size_near(_alsaHandle, alsaHwParams, &bufferSize);
     if (rc < 0) goto FailedExit;
@@ -57,6 +62,7 @@ void AlsaPlatform::Initialize(uint32_t sampleRate)
     if (rc < 0) goto FailedExit;
 
     snd_pcm_hw_params_free(alsaHwParams);
+    alsaHwParams = nullptr;
 
     // Set software parameters
 
@@ -66,32 +72,36 @@ void AlsaPlatform::Initialize(uint32_t sampleRate)
     rc = snd_pcm_sw_params_current(_alsaHandle, alsaSwParams);
     if (rc < 0) goto FailedExit;
 
-    rc = snd_pcm_sw_params_set_start_threshold(_alsaHandle, alsaSwParams, bufferSize);
+    // Start playing once there are two periods queued rather than waiting for the whole
+    // buffer, so getting going again after an underrun doesn't add latency
+    rc = snd_pcm_sw_params_set_start_threshold(_alsaHandle, alsaSwParams, std::min(periodSize * MIN_PERIODS, bufferSize));
     if (rc < 0) goto FailedExit;
 
     rc = snd_pcm_sw_params(_alsaHandle, alsaSwParams);
     if (rc < 0) goto FailedExit;
 
     snd_pcm_sw_params_free(alsaSwParams);
+    alsaSwParams = nullptr;
 
-    _sampleBufferSize = periodSize * 2;
-
-    _outputBuffers = new float*[_numOutputBuffers];
-	for (size_t i = 0; i < _numOutputBuffers; ++i)
-	{
-		_outputBuffers[i] = new float[_sampleBufferSize];
-	}
-
-    _sampleBufferIndex = 0;
+    _periodSize = periodSize;
+    _bufferSize = bufferSize;
 
     snd_pcm_prepare(_alsaHandle);
 
-    _readIndex = 0;
-    _writeIndex = 0;
-    _overlapped = false;
-
+    _producerWaiting = false;
+    _workerWaiting = false;
+    _resetRequested = false;
     _running = true;
-    _thread = std::thread(&AlsaPlatform::StreamWorker, this);
+
+    _underruns = 0;
+    _deviceDelay = 0;
+    _deviceBufferFill = 0;
+
+    if (!_mmapEnabled)
+    {
+        _ring.reset(new SampleRing(bufferSize));
+        _thread = std::thread(&AlsaPlatform::StreamWorker, this);
+    }
 
     return;
 
@@ -105,72 +115,79 @@ FailedExit:
 
 void AlsaPlatform::CleanUp()
 {
-    _running = false;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+
     _cv.notify_all();
-    _thread.join();
 
-    snd_pcm_drop(_alsaHandle);
-    
-    for (size_t i = 0; i < _numOutputBuffers; ++i)
-	{
-		delete[] _outputBuffers[i];
-	}
-	delete[] _outputBuffers;
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
 
+    snd_pcm_drop(_alsaHandle);
     snd_pcm_close(_alsaHandle);
 }
 
 void AlsaPlatform::Reset()
 {
-    std::unique_lock<std::mutex> lock(_mutex);
-
-    snd_pcm_drop(_alsaHandle);
-
-    _sampleBufferIndex = 0;
+    // Whichever thread is writing to the device does the actual reset, ALSA handles
+    // can't be used from two threads at once
+    _resetRequested = true;
 
-    _readIndex = 0;
-    _writeIndex = 0;
-    _overlapped = false;
-
-    snd_pcm_prepare(_alsaHandle);
+    if (_mmapEnabled)
+    {
+        return;
+    }
 
-    _cv.notify_all();
+    if (_workerWaiting)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.notify_all();
+    }
 }
 
 uint32_t AlsaPlatform::GetNumPendingSamples()
 {
-    std::unique_lock<std::mutex> lock(_mutex);
+    if (_mmapEnabled)
+    {
+        return _deviceBufferFill;
+    }
 
-    return _sampleBufferIndex;
+    return _ring->GetReadAvailable();
 }
 
-void AlsaPlatform::SubmitSample(float sample)
+void AlsaPlatform::SubmitSamples(const float* samples, uint32_t count)
 {
-    std::unique_lock<std::mutex> lock(_mutex);
-
-    float* buffer = _outputBuffers[_writeIndex];
-
-    buffer[_sampleBufferIndex++] = sample;
-    buffer[_sampleBufferIndex++] = sample;
+    if (_mmapEnabled)
+    {
+        WriteMapped(samples, count);
+        return;
+    }
 
-    if (_sampleBufferIndex == _sampleBufferSize)
-	{
-		_writeIndex++;
-		if (_writeIndex >= _numOutputBuffers)
-		{
-			_overlapped = true;
-			_writeIndex = 0;
-		}
+    while (count > 0)
+    {
+        uint32_t written = _ring->Write(samples, count);
+        samples += written;
+        count -= written;
 
-        _cv.notify_all();
+        // Pairs with the fence in WaitForSamples, either the worker sees the new samples
+        // or this sees that it's waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
 
-		if (_writeIndex == _readIndex && _overlapped)
-		{
-			_cv.wait(lock);
-		}
+        if (_workerWaiting)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.notify_all();
+        }
 
-		_sampleBufferIndex = 0;
-	}
+        if (count > 0)
+        {
+            WaitForSpace();
+        }
+    }
 }
 
 uint32_t AlsaPlatform::GetSampleRate()
@@ -178,50 +195,191 @@ uint32_t AlsaPlatform::GetSampleRate()
     return _sampleRate;
 }
 
-void AlsaPlatform::StreamWorker()
+void AlsaPlatform::WriteMapped(const float* samples, uint32_t count)
 {
-    float* localBuffer = new float[_sampleBufferSize];
+    if (_resetRequested.exchange(false))
+    {
+        snd_pcm_drop(_alsaHandle);
+        snd_pcm_prepare(_alsaHandle);
+    }
 
-    while (_running)
+    while (count > 0)
     {
+        // Samples are dropped rather than hanging the emulator if the device can't recover
+        snd_pcm_sframes_t available = snd_pcm_avail_update(_alsaHandle);
+        if (available < 0)
         {
-            std::unique_lock<std::mutex> lock(_mutex);
+            if (!Recover(static_cast<int>(available))) return;
+            continue;
+        }
 
-            if (_writeIndex == _readIndex && !_overlapped)
+        if (available == 0)
+        {
+            // Make sure it's actually playing before waiting for it to drain
+            if (snd_pcm_state(_alsaHandle) == SND_PCM_STATE_PREPARED)
             {
-                _cv.wait(lock);
+                snd_pcm_start(_alsaHandle);
+            }
 
-                if (!_running)
-                {
-                    break;
-                }
+            // Pacing point, same as waiting for space in the ring
+            int rc = snd_pcm_wait(_alsaHandle, 100);
+            if (rc < 0 && !Recover(rc)) return;
 
-                if (_writeIndex == _readIndex && !_overlapped)
-                {
-                    continue;
-                }
-            }
+            continue;
+        }
+
+        const snd_pcm_channel_area_t* areas;
+        snd_pcm_uframes_t offset;
+        snd_pcm_uframes_t frames = std::min(static_cast<snd_pcm_uframes_t>(count), static_cast<snd_pcm_uframes_t>(available));
 
-            memcpy(localBuffer, _outputBuffers[_readIndex], _sampleBufferSize * sizeof(float));
+        int rc = snd_pcm_mmap_begin(_alsaHandle, &areas, &offset, &frames);
+        if (rc < 0)
+        {
+            if (!Recover(rc)) return;
+            continue;
+        }
+
+        // Same mono sample to both channels. Steps are in bits.
+        for (uint32_t channel = 0; channel < 2; ++channel)
+        {
+            const snd_pcm_channel_area_t& area = areas[channel];
+            uint8_t* dest = static_cast<uint8_t*>(area.addr) + ((area.first + offset * area.step) / 8);
+            uint32_t stride = area.step / 8;
 
-            _readIndex++;
-            if (_readIndex >= _numOutputBuffers)
+            for (snd_pcm_uframes_t i = 0; i < frames; ++i, dest += stride)
             {
-                _overlapped = false;
-                _readIndex = 0;
+                *reinterpret_cast<float*>(dest) = samples[i];
             }
-            
+        }
+
+        snd_pcm_sframes_t committed = snd_pcm_mmap_commit(_alsaHandle, offset, frames);
+        if (committed < 0 || static_cast<snd_pcm_uframes_t>(committed) != frames)
+        {
+            Recover(committed < 0 ? static_cast<int>(committed) : -EPIPE);
+        }
+
+        samples += frames;
+        count -= static_cast<uint32_t>(frames);
+    }
+
+    UpdateDeviceStatistics();
+}
+
+bool AlsaPlatform::Recover(int error)
+{
+    if (error == -EPIPE)
+    {
+        _underruns++;
+    }
+
+    return snd_pcm_recover(_alsaHandle, error, 1) == 0;
+}
+
+void AlsaPlatform::UpdateDeviceStatistics()
+{
+    snd_pcm_sframes_t delay = 0;
+    if (snd_pcm_delay(_alsaHandle, &delay) == 0)
+    {
+        _deviceDelay = delay < 0 ? 0 : static_cast<uint32_t>(delay);
+    }
+
+    snd_pcm_sframes_t available = snd_pcm_avail_update(_alsaHandle);
+    if (available >= 0)
+    {
+        _deviceBufferFill = _bufferSize - std::min(static_cast<uint32_t>(available), _bufferSize);
+    }
+}
+
+bool AlsaPlatform::IsRealTime()
+{
+    return true;
+}
+
+AudioStatistics AlsaPlatform::GetStatistics()
+{
+    AudioStatistics statistics;
+    statistics.underruns = _underruns;
+    statistics.deviceDelay = _deviceDelay;
+    statistics.deviceBufferFill = _deviceBufferFill;
+    statistics.deviceBufferSize = _bufferSize;
+    statistics.queuedSamples = _mmapEnabled ? 0 : _ring->GetReadAvailable();
+    statistics.periodSize = _periodSize;
+    statistics.sampleRate = _sampleRate;
+
+    return statistics;
+}
+
+void AlsaPlatform::WaitForSpace()
+{
+    // This is the only place the emulation thread blocks on audio, and what keeps it
+    // running in step with the device
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _producerWaiting = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    _cv.wait(lock, [this]() { return _ring->GetWriteAvailable() > 0 || !_running; });
+
+    _producerWaiting = false;
+}
+
+void AlsaPlatform::WaitForSamples()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _workerWaiting = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    _cv.wait(lock, [this]() { return _ring->GetReadAvailable() >= _periodSize || _resetRequested || !_running; });
+
+    _workerWaiting = false;
+}
+
+void AlsaPlatform::StreamWorker()
+{
+    std::unique_ptr<float[]> period(new float[_periodSize]);
+    std::unique_ptr<float[]> frames(new float[_periodSize * 2]);
+
+    while (_running)
+    {
+        if (_resetRequested.exchange(false))
+        {
+            snd_pcm_drop(_alsaHandle);
+            _ring->Clear();
+            snd_pcm_prepare(_alsaHandle);
+        }
+
+        if (_ring->GetReadAvailable() < _periodSize)
+        {
+            WaitForSamples();
+            continue;
+        }
+
+        _ring->Read(period.get(), _periodSize);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (_producerWaiting)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
             _cv.notify_all();
         }
 
-        int rc = snd_pcm_writei(_alsaHandle, localBuffer, _sampleBufferSize / 2);
+        for (uint32_t i = 0; i < _periodSize; ++i)
+        {
+            frames[i * 2] = period[i];
+            frames[i * 2 + 1] = period[i];
+        }
+
+        int rc = snd_pcm_writei(_alsaHandle, frames.get(), _periodSize);
         if (rc == -EPIPE)
         {
+            _underruns++;
             snd_pcm_prepare(_alsaHandle);
         }
-    }
 
-    delete [] localBuffer;
+        UpdateDeviceStatistics();
+    }
 }
 
 #endif
\ No newline at end of file
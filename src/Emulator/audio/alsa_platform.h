@@ -3,7 +3,9 @@
 #if defined(__linux)
 
 #include "iaudio_platform.h"
+#include "sample_ring.h"
 
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <atomic>
@@ -13,31 +15,49 @@
 class AlsaPlatform : public IAudioPlatform
 {
 public:
-	virtual void Initialize(uint32_t sampleRate) override;
+	virtual void Initialize(uint32_t sampleRate, uint32_t periodLength, uint32_t numPeriods) override;
 	virtual void CleanUp() override;
 	virtual void Reset() override;
 	virtual uint32_t GetNumPendingSamples() override;
-	virtual void SubmitSample(float sample) override;
+	virtual void SubmitSamples(const float* samples, uint32_t count) override;
 	virtual uint32_t GetSampleRate() override;
+	virtual bool IsRealTime() override;
+	virtual AudioStatistics GetStatistics() override;
 private:
 	void StreamWorker();
+	void WaitForSamples();
+	void WaitForSpace();
+	void WriteMapped(const float* samples, uint32_t count);
+	bool Recover(int error);
+	void UpdateDeviceStatistics();
 
 	snd_pcm_t* _alsaHandle;
 	uint32_t _sampleRate;
-	uint32_t _sampleBufferSize;
-	uint32_t _sampleBufferIndex;
+	uint32_t _periodSize;
+	uint32_t _bufferSize;
 
-	uint32_t _numOutputBuffers;
-	uint32_t _writeIndex;
-	uint32_t _readIndex;
-	bool _overlapped;
-	float** _outputBuffers;
+	// When the device can be memory mapped the emulation thread writes samples straight
+	// into its ring buffer and there's no worker thread or ring of our own at all
+	bool _mmapEnabled;
+
+	// Samples go from the emulation thread to the stream worker through a lock-free ring.
+	// The mutex and condition variable are only touched when one side has to sleep
+	// because the ring is full or empty, the flags say whether the other side needs waking.
+	std::unique_ptr<SampleRing> _ring;
+	std::atomic<bool> _producerWaiting;
+	std::atomic<bool> _workerWaiting;
+	std::atomic<bool> _resetRequested;
 
 	std::mutex _mutex;
 	std::condition_variable _cv;
 	std::thread _thread;
 
 	std::atomic<bool> _running;
+
+	// Written by whichever thread is talking to the device, read from anywhere
+	std::atomic<uint32_t> _underruns;
+	std::atomic<uint32_t> _deviceDelay;
+	std::atomic<uint32_t> _deviceBufferFill;
 };
 
 #endif
\ No newline at end of file
@@ -1,35 +1,171 @@
 #include "audio_backend.h"
 #include "iaudio_platform.h"
+#include "time_stretcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace
+{
+// How much sped up audio can be queued for the time stretcher, in seconds of input
+constexpr double FAST_FORWARD_BUFFER_LENGTH = 0.5;
+
+// How often the speed of the incoming audio is measured
+constexpr std::chrono::milliseconds SPEED_MEASUREMENT_INTERVAL(100);
+
+// Samples handed to the time stretcher at a time
+constexpr uint32_t FAST_FORWARD_READ_SIZE = 1024;
+}
 
 const int AudioBackend::DEFAULT_SAMPLE_RATE = 44100;
+const uint32_t AudioBackend::DEFAULT_PERIOD_LENGTH = 4;
+const uint32_t AudioBackend::DEFAULT_NUM_PERIODS = 4;
 
-AudioBackend::AudioBackend(uint32_t sampleRate)
+AudioBackend::AudioBackend(AudioOutput output, const std::string& path, uint32_t sampleRate)
+	: _sampleRate(sampleRate)
+	, _open(false)
+	, _fastForwarding(false)
+	, _fastForwardSamples(0)
 {
-	_backend = IAudioPlatform::CreateAudioPlatform();
-	_backend->Initialize(sampleRate);
+	_backend = IAudioPlatform::CreateAudioPlatform(output, path);
 }
 
 AudioBackend::~AudioBackend()
 {
-	_backend->CleanUp();
+	if (_open)
+	{
+		SetFastForwardEnabled(false);
+		_backend->CleanUp();
+	}
+}
+
+void AudioBackend::Open(uint32_t periodLength, uint32_t numPeriods)
+{
+	_backend->Initialize(_sampleRate, periodLength, numPeriods);
+	_open = true;
 }
 
 void AudioBackend::Reset()
 {
-	_backend->Reset();
+	if (_open)
+	{
+		_backend->Reset();
+	}
 }
 
 uint32_t AudioBackend::GetNumPendingSamples()
 {
-	return _backend->GetNumPendingSamples();
+	return _open ? _backend->GetNumPendingSamples() : 0;
 }
 
-void AudioBackend::SubmitSample(float sample)
+void AudioBackend::SubmitSamples(const float* samples, uint32_t count)
 {
-	_backend->SubmitSample(sample);
+	if (!_open)
+	{
+		return;
+	}
+
+	if (_fastForwarding)
+	{
+		_fastForwardRing->Write(samples, count);
+		_fastForwardSamples += count;
+		return;
+	}
+
+	_backend->SubmitSamples(samples, count);
 }
 
 uint32_t AudioBackend::GetSampleRate()
 {
-	return _backend->GetSampleRate();
+	return _open ? _backend->GetSampleRate() : _sampleRate;
+}
+
+bool AudioBackend::IsRealTime()
+{
+	return _backend->IsRealTime();
+}
+
+AudioStatistics AudioBackend::GetStatistics()
+{
+	if (!_open)
+	{
+		return AudioStatistics();
+	}
+
+	return _backend->GetStatistics();
+}
+
+void AudioBackend::SetFastForwardEnabled(bool enabled)
+{
+	// Outputs that aren't real time already take samples as fast as they come
+	if (enabled == _fastForwarding || (enabled && (!_open || !_backend->IsRealTime())))
+	{
+		return;
+	}
+
+	if (enabled)
+	{
+		uint32_t sampleRate = _backend->GetSampleRate();
+		_fastForwardRing.reset(new SampleRing(static_cast<uint32_t>(sampleRate * FAST_FORWARD_BUFFER_LENGTH)));
+		_fastForwardSamples = 0;
+		_fastForwarding = true;
+		_fastForwardThread = std::thread(&AudioBackend::FastForwardWorker, this);
+	}
+	else
+	{
+		// The worker may be waiting on the device for up to a period, after that this
+		// thread is the only one submitting again
+		_fastForwarding = false;
+		_fastForwardThread.join();
+		_fastForwardRing.reset();
+	}
+}
+
+void AudioBackend::FastForwardWorker()
+{
+	typedef std::chrono::steady_clock Clock;
+
+	uint32_t sampleRate = _backend->GetSampleRate();
+	TimeStretcher stretcher(sampleRate);
+
+	std::vector<float> input(FAST_FORWARD_READ_SIZE);
+	std::vector<float> output;
+
+	Clock::time_point measurementStart = Clock::now();
+	uint64_t measurementSamples = 0;
+	double speed = 1.0;
+
+	while (_fastForwarding)
+	{
+		uint32_t count = _fastForwardRing->Read(input.data(), FAST_FORWARD_READ_SIZE);
+		if (count == 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		// Audio arrives as many times faster than real time as emulation is running.
+		// Submitting to the device blocks in real time, so this loop runs at the
+		// device's pace and the time between measurements is real time.
+		Clock::time_point now = Clock::now();
+		if (now - measurementStart >= SPEED_MEASUREMENT_INTERVAL)
+		{
+			uint64_t samples = _fastForwardSamples;
+			double seconds = std::chrono::duration<double>(now - measurementStart).count();
+			double measured = (samples - measurementSamples) / (seconds * sampleRate);
+
+			speed += (measured - speed) * 0.5;
+			measurementStart = now;
+			measurementSamples = samples;
+		}
+
+		// Lean on the ratio a bit to keep the queue half full, which absorbs errors
+		// in the measured speed before anything has to be dropped
+		double fill = static_cast<double>(_fastForwardRing->GetReadAvailable()) / _fastForwardRing->GetCapacity();
+		stretcher.SetRatio(std::max(speed, 1.0) * (0.5 + fill));
+
+		stretcher.Process(input.data(), count, output);
+		_backend->SubmitSamples(output.data(), static_cast<uint32_t>(output.size()));
+	}
 }
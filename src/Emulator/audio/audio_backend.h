@@ -2,22 +2,54 @@
 
 #include <memory>
 #include <atomic>
+#include <string>
+#include <thread>
 
-class IAudioPlatform;
+#include "iaudio_platform.h"
+#include "sample_ring.h"
 
 class AudioBackend
 {
 public:
-	AudioBackend(uint32_t sampleRate = DEFAULT_SAMPLE_RATE);
+	// The output isn't opened until Open is called. Until then samples are discarded and
+	// the sample rate is the one asked for here.
+	AudioBackend(AudioOutput output = AudioOutput::Device, const std::string& path = "", uint32_t sampleRate = DEFAULT_SAMPLE_RATE);
 	~AudioBackend();
 
+	// Open the output with a period length (in milliseconds) and number of periods. Only
+	// call once, from the thread that will be submitting samples. The device may settle
+	// on a different sample rate than the one asked for.
+	void Open(uint32_t periodLength = DEFAULT_PERIOD_LENGTH, uint32_t numPeriods = DEFAULT_NUM_PERIODS);
+
 	void Reset();
 	uint32_t GetNumPendingSamples();
-	void SubmitSample(float sample);
+	void SubmitSamples(const float* samples, uint32_t count);
 	uint32_t GetSampleRate();
+	bool IsRealTime();
+
+	// Safe to call from any thread, all zero until the output is open
+	AudioStatistics GetStatistics();
+
+	// For when emulation runs faster than real time. Samples submitted while this is on
+	// are time stretched back down to real time on a thread of their own, keeping their
+	// pitch, and SubmitSamples never blocks. Only call from the thread submitting samples.
+	void SetFastForwardEnabled(bool enabled);
 
 	static const int DEFAULT_SAMPLE_RATE;
+	static const uint32_t DEFAULT_PERIOD_LENGTH;
+	static const uint32_t DEFAULT_NUM_PERIODS;
 
 private:
+	void FastForwardWorker();
+
+	uint32_t _sampleRate;
+	std::atomic<bool> _open;
+
+	// Samples on their way to the time stretcher. Anything that doesn't fit is dropped.
+	std::unique_ptr<SampleRing> _fastForwardRing;
+	std::atomic<bool> _fastForwarding;
+	std::atomic<uint64_t> _fastForwardSamples; // Every sample submitted, including the dropped ones
+	std::thread _fastForwardThread;
+
 	std::unique_ptr<IAudioPlatform> _backend;
 };
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "blip_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr double PI = 3.14159265358979323846;
+
+// Fraction of the output Nyquist frequency that's let through. Leaves some room for the
+// window's transition band so very little folds back below Nyquist.
+constexpr double CUTOFF = 0.9;
+}
+
+float BlipBuffer::Kernel[BlipBuffer::PHASES][BlipBuffer::WIDTH];
+
+bool BlipBuffer::BuildKernel()
+{
+	for (uint32_t phase = 0; phase < PHASES; ++phase)
+	{
+		double fraction = static_cast<double>(phase) / PHASES;
+		double sum = 0.0;
+
+		for (uint32_t i = 0; i < WIDTH; ++i)
+		{
+			// Distance from the delta to this sample, output is delayed HALF_WIDTH samples
+			double t = static_cast<double>(i) - fraction - HALF_WIDTH;
+			double x = CUTOFF * t;
+			double sinc = (x == 0.0) ? 1.0 : std::sin(PI * x) / (PI * x);
+
+			// Blackman window spanning the width of the kernel
+			double w = t / (2.0 * (HALF_WIDTH + 1));
+			double window = 0.42 + 0.5 * std::cos(2.0 * PI * w) + 0.08 * std::cos(4.0 * PI * w);
+
+			Kernel[phase][i] = static_cast<float>(sinc * window);
+			sum += Kernel[phase][i];
+		}
+
+		// Each impulse has to add up to exactly the delta or the output drifts
+		for (uint32_t i = 0; i < WIDTH; ++i)
+		{
+			Kernel[phase][i] = static_cast<float>(Kernel[phase][i] / sum);
+		}
+	}
+
+	return true;
+}
+
+BlipBuffer::BlipBuffer()
+	: _factor(0)
+	, _offset(0)
+	, _integrator(0.0f)
+{
+	static const bool kernelBuilt = BuildKernel();
+	(void)kernelBuilt;
+}
+
+void BlipBuffer::SetRates(double clockRate, double sampleRate, uint32_t maxClocks)
+{
+	_factor = static_cast<uint64_t>(std::llround((sampleRate / clockRate) * static_cast<double>(1ULL << TIME_BITS)));
+
+	uint64_t maxSamples = ((static_cast<uint64_t>(maxClocks) * _factor) >> TIME_BITS) + 1;
+	_buffer.assign(static_cast<size_t>(maxSamples) + WIDTH + 1, 0.0f);
+
+	Clear(_integrator);
+}
+
+void BlipBuffer::Clear(float level)
+{
+	std::fill(_buffer.begin(), _buffer.end(), 0.0f);
+	_offset = 0;
+	_integrator = level;
+}
+
+void BlipBuffer::AddDelta(uint32_t clock, float delta)
+{
+	uint64_t position = _offset + (clock * _factor);
+	uint32_t phase = static_cast<uint32_t>(position >> (TIME_BITS - PHASE_BITS)) & (PHASES - 1);
+
+	const float* kernel = Kernel[phase];
+	float* out = &_buffer[static_cast<size_t>(position >> TIME_BITS)];
+
+	for (uint32_t i = 0; i < WIDTH; ++i)
+	{
+		out[i] += kernel[i] * delta;
+	}
+}
+
+void BlipBuffer::EndBlock(uint32_t clocks)
+{
+	_offset += clocks * _factor;
+}
+
+uint32_t BlipBuffer::GetSamplesAvailable()
+{
+	return static_cast<uint32_t>(_offset >> TIME_BITS);
+}
+
+uint32_t BlipBuffer::ReadSamples(float* samples, uint32_t count)
+{
+	count = std::min(count, GetSamplesAvailable());
+
+	float sum = _integrator;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		sum += _buffer[i];
+		samples[i] = sum;
+	}
+
+	_integrator = sum;
+
+	// Shift whatever is left, including the tails of the last few deltas, down to the start
+	size_t remaining = static_cast<size_t>(GetSamplesAvailable() - count) + WIDTH;
+	memmove(_buffer.data(), _buffer.data() + count, remaining * sizeof(float));
+	std::fill(_buffer.begin() + remaining, _buffer.begin() + remaining + count, 0.0f);
+
+	_offset -= static_cast<uint64_t>(count) << TIME_BITS;
+
+	return count;
+}
+
+void BlipBuffer::SetLevel(float level)
+{
+	// Everything still in the buffer will eventually be added to the integrator
+	size_t pending = static_cast<size_t>(GetSamplesAvailable()) + WIDTH;
+
+	float sum = 0.0f;
+	for (size_t i = 0; i < pending; ++i)
+	{
+		sum += _buffer[i];
+	}
+
+	_integrator = level - sum;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Band-limited synthesis buffer in the style of blip_buf. Instead of sampling a signal
+// at every clock, the caller adds the change in amplitude at the clock it happens on.
+// Each change is spread over a few output samples with a windowed sinc so the steps
+// come out band-limited, and the output is the running sum of those changes. Samples
+// are then read out in blocks at the output rate.
+class BlipBuffer
+{
+public:
+	BlipBuffer();
+
+	// Set the input clock rate and output sample rate. maxClocks is the longest block
+	// that will be passed to EndBlock. Clears the buffer.
+	void SetRates(double clockRate, double sampleRate, uint32_t maxClocks);
+
+	// Discard all pending samples and set the output to level
+	void Clear(float level);
+
+	// Add a change in amplitude at the given clock, relative to the start of the block
+	void AddDelta(uint32_t clock, float delta);
+
+	// Finish the current block after the given number of clocks. Samples up to that
+	// point become available to read.
+	void EndBlock(uint32_t clocks);
+
+	uint32_t GetSamplesAvailable();
+
+	// Read up to count samples out and remove them from the buffer, returns how many
+	// were read. Everything available has to be read before the next block is ended.
+	uint32_t ReadSamples(float* samples, uint32_t count);
+
+	// Correct the running sum so the output settles at exactly level, otherwise rounding
+	// in the kernel lets it slowly wander. Only valid when level is what the deltas
+	// added so far sum to.
+	void SetLevel(float level);
+
+private:
+	static constexpr uint32_t HALF_WIDTH = 8;
+	static constexpr uint32_t WIDTH = HALF_WIDTH * 2;
+	static constexpr uint32_t PHASE_BITS = 5;
+	static constexpr uint32_t PHASES = 1 << PHASE_BITS;
+	static constexpr uint32_t TIME_BITS = 32;
+
+	// Impulse response for each fractional position of a delta between two samples
+	static float Kernel[PHASES][WIDTH];
+	static bool BuildKernel();
+
+	uint64_t _factor;  // Output samples per clock, 32.32 fixed point
+	uint64_t _offset;  // Position of the start of the current block, 32.32 fixed point
+	float _integrator;
+	std::vector<float> _buffer;
+};
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "iaudio_platform.h"
+#include "null_audio_platform.h"
+#include "wav_file_platform.h"
 
 #if defined(_WIN32)
 #include "xaudio2_platform.h"
@@ -6,8 +8,17 @@
 #include "alsa_platform.h"
 #endif
 
-std::unique_ptr<IAudioPlatform> IAudioPlatform::CreateAudioPlatform()
+std::unique_ptr<IAudioPlatform> IAudioPlatform::CreateAudioPlatform(AudioOutput output, const std::string& path)
 {
+	if (output == AudioOutput::Null)
+	{
+		return std::unique_ptr<IAudioPlatform>(new NullAudioPlatform());
+	}
+	else if (output == AudioOutput::WavFile)
+	{
+		return std::unique_ptr<IAudioPlatform>(new WavFilePlatform(path));
+	}
+
 #if defined(_WIN32)
 	return std::unique_ptr<IAudioPlatform>(new XAudio2Platform());
 #elif defined(__linux)
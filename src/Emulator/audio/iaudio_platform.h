@@ -2,18 +2,48 @@
 
 #include <cstdint>
 #include <memory>
+#include <string>
+
+// Counters for tuning audio latency, all sizes are in samples
+struct AudioStatistics
+{
+	uint32_t underruns;        // Times the device ran out of samples to play
+	uint32_t deviceDelay;      // How long until a sample submitted now is heard, as reported by the device
+	uint32_t deviceBufferFill; // Samples waiting in the device's buffer
+	uint32_t deviceBufferSize;
+	uint32_t queuedSamples;    // Samples waiting to be handed to the device
+	uint32_t periodSize;
+	uint32_t sampleRate;
+};
+
+// Where audio goes, chosen when the NES is created
+enum class AudioOutput
+{
+	Device,  // The system's sound device
+	Null,    // Nowhere, for machines without a sound device
+	WavFile  // A WAV file, for capturing exactly what would have been played
+};
 
 class IAudioPlatform
 {
 public:
-	static std::unique_ptr<IAudioPlatform> CreateAudioPlatform();
+	// path is the file to write to for AudioOutput::WavFile and ignored otherwise
+	static std::unique_ptr<IAudioPlatform> CreateAudioPlatform(AudioOutput output = AudioOutput::Device, const std::string& path = "");
 
-	virtual void Initialize(uint32_t sampleRate) = 0;
+	// The device's buffer is split into numPeriods periods of periodLength milliseconds,
+	// which together set the output latency
+	virtual void Initialize(uint32_t sampleRate, uint32_t periodLength, uint32_t numPeriods) = 0;
 	virtual void CleanUp() = 0;
 	virtual void Reset() = 0;
 	virtual uint32_t GetNumPendingSamples() = 0;
-	virtual void SubmitSample(float sample) = 0;
+	// Queue mono samples for playback. Blocks while the queue is full, which is what
+	// paces emulation to the audio device.
+	virtual void SubmitSamples(const float* samples, uint32_t count) = 0;
 	virtual uint32_t GetSampleRate() = 0;
+	// Whether SubmitSamples keeps pace with real time playback. When it doesn't, the
+	// emulator has to pace itself.
+	virtual bool IsRealTime() = 0;
+	virtual AudioStatistics GetStatistics() = 0;
 
 	virtual ~IAudioPlatform() = default;
 };
\ No newline at end of file
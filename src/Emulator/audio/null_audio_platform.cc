@@ -0,0 +1,46 @@
+#include "null_audio_platform.h"
+
+NullAudioPlatform::NullAudioPlatform()
+	: _sampleRate(0)
+{
+}
+
+void NullAudioPlatform::Initialize(uint32_t sampleRate, uint32_t, uint32_t)
+{
+	_sampleRate = sampleRate;
+}
+
+void NullAudioPlatform::CleanUp()
+{
+}
+
+void NullAudioPlatform::Reset()
+{
+}
+
+uint32_t NullAudioPlatform::GetNumPendingSamples()
+{
+	return 0;
+}
+
+void NullAudioPlatform::SubmitSamples(const float*, uint32_t)
+{
+}
+
+uint32_t NullAudioPlatform::GetSampleRate()
+{
+	return _sampleRate;
+}
+
+bool NullAudioPlatform::IsRealTime()
+{
+	return false;
+}
+
+AudioStatistics NullAudioPlatform::GetStatistics()
+{
+	AudioStatistics statistics = {};
+	statistics.sampleRate = _sampleRate;
+
+	return statistics;
+}
\ No newline at end of file
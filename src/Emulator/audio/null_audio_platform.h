@@ -0,0 +1,22 @@
+#pragma once
+
+#include "iaudio_platform.h"
+
+// Accepts samples and throws them away, for running without a sound device
+class NullAudioPlatform : public IAudioPlatform
+{
+public:
+	NullAudioPlatform();
+
+	virtual void Initialize(uint32_t sampleRate, uint32_t periodLength, uint32_t numPeriods) override;
+	virtual void CleanUp() override;
+	virtual void Reset() override;
+	virtual uint32_t GetNumPendingSamples() override;
+	virtual void SubmitSamples(const float* samples, uint32_t count) override;
+	virtual uint32_t GetSampleRate() override;
+	virtual bool IsRealTime() override;
+	virtual AudioStatistics GetStatistics() override;
+
+private:
+	uint32_t _sampleRate;
+};
\ No newline at end of file
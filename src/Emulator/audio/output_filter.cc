@@ -0,0 +1,74 @@
+#include "output_filter.h"
+
+namespace
+{
+constexpr double PI = 3.14159265358979323846;
+
+constexpr double FIRST_HIGH_PASS = 90.0;
+constexpr double SECOND_HIGH_PASS = 440.0;
+constexpr double LOW_PASS = 14000.0;
+
+void setHighPass(double cutoff, double sampleRate, float& c0, float& c1, float& c2)
+{
+	double rc = 1.0 / (2.0 * PI * cutoff);
+	double alpha = rc / (rc + (1.0 / sampleRate));
+
+	// y[n] = alpha * (y[n - 1] + x[n] - x[n - 1])
+	c0 = static_cast<float>(alpha);
+	c1 = static_cast<float>(-alpha);
+	c2 = static_cast<float>(alpha);
+}
+
+void setLowPass(double cutoff, double sampleRate, float& c0, float& c1, float& c2)
+{
+	double rc = 1.0 / (2.0 * PI * cutoff);
+	double dt = 1.0 / sampleRate;
+	double alpha = dt / (rc + dt);
+
+	// y[n] = y[n - 1] + alpha * (x[n] - y[n - 1])
+	c0 = static_cast<float>(alpha);
+	c1 = 0.0f;
+	c2 = static_cast<float>(1.0 - alpha);
+}
+}
+
+OutputFilter::OutputFilter()
+{
+	SetSampleRate(48000.0);
+}
+
+void OutputFilter::SetSampleRate(double sampleRate)
+{
+	setHighPass(FIRST_HIGH_PASS, sampleRate, _c0[0], _c1[0], _c2[0]);
+	setHighPass(SECOND_HIGH_PASS, sampleRate, _c0[1], _c1[1], _c2[1]);
+	setLowPass(LOW_PASS, sampleRate, _c0[2], _c1[2], _c2[2]);
+
+	Reset();
+}
+
+void OutputFilter::Reset()
+{
+	for (uint32_t i = 0; i < STAGES; ++i)
+	{
+		_lastInput[i] = 0.0f;
+		_lastOutput[i] = 0.0f;
+	}
+}
+
+void OutputFilter::Process(float* samples, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float sample = samples[i];
+
+		for (uint32_t stage = 0; stage < STAGES; ++stage)
+		{
+			float output = _c0[stage] * sample + _c1[stage] * _lastInput[stage] + _c2[stage] * _lastOutput[stage];
+			_lastInput[stage] = sample;
+			_lastOutput[stage] = output;
+			sample = output;
+		}
+
+		samples[i] = sample;
+	}
+}
\ No newline at end of file
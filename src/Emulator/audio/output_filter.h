@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+// The filters between the NES's DAC and its audio output. Two first order high-pass
+// filters at 90 Hz and 440 Hz take out the DC offset the mixer leaves and thin out the
+// bass, then a first order low-pass at 14 kHz softens the top end.
+//
+// Each stage is y[n] = c0 * x[n] + c1 * x[n - 1] + c2 * y[n - 1], run one after the
+// other on every sample.
+class OutputFilter
+{
+public:
+	OutputFilter();
+
+	// Recalculate the coefficients for a new rate and reset
+	void SetSampleRate(double sampleRate);
+
+	// Forget the filter history, as if the input had been silent forever
+	void Reset();
+
+	// Filter count samples in place
+	void Process(float* samples, uint32_t count);
+
+private:
+	static constexpr uint32_t STAGES = 3;
+
+	// Coefficients and state, indexed by stage
+	float _c0[STAGES];
+	float _c1[STAGES];
+	float _c2[STAGES];
+	float _lastInput[STAGES];
+	float _lastOutput[STAGES];
+};
\ No newline at end of file
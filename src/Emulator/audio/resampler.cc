@@ -0,0 +1,164 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESAMPLER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+constexpr double PI = 3.14159265358979323846;
+
+// Fraction of the lower of the two Nyquist frequencies that's let through
+constexpr double CUTOFF = 0.9;
+
+constexpr double MIN_ADJUSTMENT = 0.9;
+constexpr double MAX_ADJUSTMENT = 1.1;
+
+// Dot products of input against two adjacent kernel phases at once, so each input
+// sample only has to be loaded once
+void dotProducts(const float* input, const float* kernel0, const float* kernel1, uint32_t taps, float& result0, float& result1)
+{
+#if defined(RESAMPLER_SSE2)
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+
+	for (uint32_t i = 0; i < taps; i += 4)
+	{
+		__m128 samples = _mm_loadu_ps(input + i);
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(samples, _mm_loadu_ps(kernel0 + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(samples, _mm_loadu_ps(kernel1 + i)));
+	}
+
+	// Horizontal add of both accumulators
+	__m128 low = _mm_unpacklo_ps(sum0, sum1);  // a0 b0 a1 b1
+	__m128 high = _mm_unpackhi_ps(sum0, sum1); // a2 b2 a3 b3
+	__m128 pairs = _mm_add_ps(low, high);      // a0+a2 b0+b2 a1+a3 b1+b3
+	__m128 totals = _mm_add_ps(pairs, _mm_movehl_ps(pairs, pairs));
+
+	result0 = _mm_cvtss_f32(totals);
+	result1 = _mm_cvtss_f32(_mm_shuffle_ps(totals, totals, _MM_SHUFFLE(1, 1, 1, 1)));
+#else
+	float sum0[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float sum1[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	// Same four way split as the SIMD path, which also lets the compiler vectorize it
+	for (uint32_t i = 0; i < taps; i += 4)
+	{
+		for (uint32_t j = 0; j < 4; ++j)
+		{
+			sum0[j] += input[i + j] * kernel0[i + j];
+			sum1[j] += input[i + j] * kernel1[i + j];
+		}
+	}
+
+	result0 = (sum0[0] + sum0[2]) + (sum0[1] + sum0[3]);
+	result1 = (sum1[0] + sum1[2]) + (sum1[1] + sum1[3]);
+#endif
+}
+}
+
+Resampler::Resampler()
+	: _inputRate(1.0)
+	, _outputRate(1.0)
+	, _adjustment(1.0)
+	, _step(0)
+	, _position(0)
+{
+	SetRates(1.0, 1.0);
+}
+
+void Resampler::SetRates(double inputRate, double outputRate)
+{
+	_inputRate = inputRate;
+	_outputRate = outputRate;
+
+	// When going down in rate the kernel has to cut off below the output's Nyquist
+	// frequency instead of the input's, in input samples that means stretching the sinc
+	double cutoff = CUTOFF * std::min(1.0, outputRate / inputRate);
+
+	_kernel.resize((PHASES + 1) * TAPS);
+
+	for (uint32_t phase = 0; phase <= PHASES; ++phase)
+	{
+		double fraction = static_cast<double>(phase) / PHASES;
+		float* row = &_kernel[phase * TAPS];
+		double sum = 0.0;
+
+		for (uint32_t i = 0; i < TAPS; ++i)
+		{
+			// Output sits fraction of the way between taps HALF_TAPS - 1 and HALF_TAPS
+			double t = static_cast<double>(i) - (HALF_TAPS - 1) - fraction;
+			double x = cutoff * t;
+			double sinc = (x == 0.0) ? 1.0 : std::sin(PI * x) / (PI * x);
+
+			// Blackman window spanning the width of the kernel
+			double w = t / TAPS;
+			double window = 0.42 + 0.5 * std::cos(2.0 * PI * w) + 0.08 * std::cos(4.0 * PI * w);
+
+			row[i] = static_cast<float>(sinc * window);
+			sum += row[i];
+		}
+
+		// Unity gain at DC for every phase, otherwise a constant input comes out rippling
+		for (uint32_t i = 0; i < TAPS; ++i)
+		{
+			row[i] = static_cast<float>(row[i] / sum);
+		}
+	}
+
+	UpdateStep();
+	Reset(_history.empty() ? 0.0f : _history.back());
+}
+
+void Resampler::SetRatioAdjustment(double adjustment)
+{
+	_adjustment = std::max(MIN_ADJUSTMENT, std::min(adjustment, MAX_ADJUSTMENT));
+	UpdateStep();
+}
+
+void Resampler::UpdateStep()
+{
+	double step = _inputRate / (_outputRate * _adjustment);
+	_step = static_cast<uint64_t>(std::llround(step * static_cast<double>(1ULL << TIME_BITS)));
+}
+
+void Resampler::Reset(float level)
+{
+	// Enough history that the first output sample lands on the first real input sample
+	_history.assign(HALF_TAPS - 1, level);
+	_position = 0;
+}
+
+void Resampler::Process(const float* input, uint32_t count, std::vector<float>& output)
+{
+	output.clear();
+	_history.insert(_history.end(), input, input + count);
+
+	const size_t available = _history.size();
+	const float fractionScale = 1.0f / static_cast<float>(1U << FRACTION_BITS);
+
+	while ((_position >> TIME_BITS) + TAPS <= available)
+	{
+		size_t base = static_cast<size_t>(_position >> TIME_BITS);
+		uint32_t fraction = static_cast<uint32_t>(_position);
+		uint32_t phase = fraction >> FRACTION_BITS;
+		float interpolation = static_cast<float>(fraction & ((1U << FRACTION_BITS) - 1)) * fractionScale;
+
+		const float* kernel = &_kernel[phase * TAPS];
+
+		float sample0, sample1;
+		dotProducts(&_history[base], kernel, kernel + TAPS, TAPS, sample0, sample1);
+		output.push_back(sample0 + (sample1 - sample0) * interpolation);
+
+		_position += _step;
+	}
+
+	// Drop the input that no future output sample can reach
+	size_t consumed = std::min(static_cast<size_t>(_position >> TIME_BITS), available);
+	_history.erase(_history.begin(), _history.begin() + consumed);
+	_position -= static_cast<uint64_t>(consumed) << TIME_BITS;
+}
\ No newline at end of file
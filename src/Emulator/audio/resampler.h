@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Polyphase windowed sinc resampler. Converts a stream of samples at one rate to another
+// rate with an arbitrary, fractional ratio between them. The ratio can also be nudged
+// continuously while running, which is how the output is kept in step with the device.
+//
+// The kernel is stored for a fixed number of fractional positions between two input
+// samples, and the coefficients for positions in between are interpolated from the two
+// nearest phases.
+class Resampler
+{
+public:
+	Resampler();
+
+	// Set the input and output sample rates, rebuilds the kernel and resets the stream
+	void SetRates(double inputRate, double outputRate);
+
+	// Scale the output rate by adjustment without rebuilding the kernel. Values above 1
+	// produce more output samples per input sample. Meant for small corrections, it's
+	// clamped to within 10% either way.
+	void SetRatioAdjustment(double adjustment);
+
+	// Discard any buffered input and start again as if the input had been level forever
+	void Reset(float level);
+
+	// Resample count input samples. output is replaced with however many output samples
+	// are ready, the last few input samples are held back until there's enough input
+	// after them to fill the kernel.
+	void Process(const float* input, uint32_t count, std::vector<float>& output);
+
+private:
+	static constexpr uint32_t TAPS = 32; // Multiple of 4 so the kernel can be processed in SIMD lanes
+	static constexpr uint32_t HALF_TAPS = TAPS / 2;
+	static constexpr uint32_t PHASE_BITS = 7;
+	static constexpr uint32_t PHASES = 1 << PHASE_BITS;
+	static constexpr uint32_t TIME_BITS = 32;
+	static constexpr uint32_t FRACTION_BITS = TIME_BITS - PHASE_BITS;
+
+	void UpdateStep();
+
+	double _inputRate;
+	double _outputRate;
+	double _adjustment;
+
+	uint64_t _step;     // Input samples per output sample, 32.32 fixed point
+	uint64_t _position; // Position of the next output sample in _history, 32.32 fixed point
+
+	std::vector<float> _kernel; // PHASES + 1 rows of TAPS coefficients
+	std::vector<float> _history;
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "sample_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+SampleRing::SampleRing(uint32_t capacity)
+	: _capacity(capacity)
+	, _mask(0)
+	, _writePosition(0)
+	, _readPosition(0)
+{
+	uint32_t size = 1;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+
+	_buffer.reset(new float[size]);
+	_mask = size - 1;
+}
+
+uint32_t SampleRing::Write(const float* samples, uint32_t count)
+{
+	uint32_t write = _writePosition.load(std::memory_order_relaxed);
+	uint32_t read = _readPosition.load(std::memory_order_acquire);
+
+	count = std::min(count, _capacity - (write - read));
+
+	uint32_t start = write & _mask;
+	uint32_t first = std::min(count, _mask + 1 - start);
+	memcpy(_buffer.get() + start, samples, first * sizeof(float));
+	memcpy(_buffer.get(), samples + first, (count - first) * sizeof(float));
+
+	_writePosition.store(write + count, std::memory_order_release);
+
+	return count;
+}
+
+uint32_t SampleRing::GetWriteAvailable() const
+{
+	return _capacity - (_writePosition.load(std::memory_order_relaxed) - _readPosition.load(std::memory_order_acquire));
+}
+
+uint32_t SampleRing::Read(float* samples, uint32_t count)
+{
+	uint32_t read = _readPosition.load(std::memory_order_relaxed);
+	uint32_t write = _writePosition.load(std::memory_order_acquire);
+
+	count = std::min(count, write - read);
+
+	uint32_t start = read & _mask;
+	uint32_t first = std::min(count, _mask + 1 - start);
+	memcpy(samples, _buffer.get() + start, first * sizeof(float));
+	memcpy(samples + first, _buffer.get(), (count - first) * sizeof(float));
+
+	_readPosition.store(read + count, std::memory_order_release);
+
+	return count;
+}
+
+uint32_t SampleRing::GetReadAvailable() const
+{
+	return _writePosition.load(std::memory_order_acquire) - _readPosition.load(std::memory_order_relaxed);
+}
+
+void SampleRing::Clear()
+{
+	_readPosition.store(_writePosition.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+uint32_t SampleRing::GetCapacity() const
+{
+	return _capacity;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Lock-free ring buffer of samples between exactly one producer thread and one consumer
+// thread. Each side only ever writes its own position, so neither has to lock.
+class SampleRing
+{
+public:
+	// Holds up to capacity samples
+	explicit SampleRing(uint32_t capacity);
+
+	// Producer side. Copies in as many samples as fit and returns how many that was.
+	uint32_t Write(const float* samples, uint32_t count);
+	uint32_t GetWriteAvailable() const;
+
+	// Consumer side. Copies out up to count samples and returns how many that was.
+	uint32_t Read(float* samples, uint32_t count);
+	uint32_t GetReadAvailable() const;
+
+	// Consumer side. Drop everything that's currently queued.
+	void Clear();
+
+	uint32_t GetCapacity() const;
+
+private:
+	// Storage is a power of two so positions can run freely and wrap with a mask
+	std::unique_ptr<float[]> _buffer;
+	uint32_t _capacity;
+	uint32_t _mask;
+
+	// Kept on separate cache lines so the two threads don't contend over them
+	char _padding0[64];
+	std::atomic<uint32_t> _writePosition;
+	char _padding1[64];
+	std::atomic<uint32_t> _readPosition;
+	char _padding2[64];
+};
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "stem_recorder.h"
+#include "wav_header.h"
+
+#include <fstream>
+#include <limits>
+
+namespace
+{
+const char* const STEM_NAMES[] = { "pulse1", "pulse2", "triangle", "noise", "dmc" };
+}
+
+StemRecorder::StemRecorder(const std::string& pathPrefix, uint32_t sampleRate)
+	: _sampleRate(sampleRate)
+	, _samplesRecorded(0)
+	, _finished(false)
+{
+	uint8_t header[WAV_HEADER_SIZE];
+	BuildWavHeader(header, WavSampleFormat::UnsignedByte, _sampleRate, 1, 0);
+
+	for (uint32_t i = 0; i < NUM_STEMS; ++i)
+	{
+		_paths[i] = pathPrefix + "_" + STEM_NAMES[i] + ".wav";
+		_files[i] = _writer.Open(_paths[i]);
+	}
+
+	// Placeholder until Finish knows the sizes
+	for (uint32_t i = 0; i < NUM_STEMS; ++i)
+	{
+		_writer.Write(_files[i], header, WAV_HEADER_SIZE);
+	}
+}
+
+StemRecorder::~StemRecorder()
+{
+	Finish();
+}
+
+void StemRecorder::Record(uint8_t pulseOne, uint8_t pulseTwo, uint8_t triangle, uint8_t noise, uint8_t dmc)
+{
+	// The data chunk size is 32 bits, which is over a day at any sensible rate
+	if (_samplesRecorded >= std::numeric_limits<uint32_t>::max() - WAV_HEADER_SIZE)
+	{
+		return;
+	}
+
+	// Scale to the full 8 bits, 15 * 17 = 255 and 127 * 2 = 254
+	uint8_t samples[NUM_STEMS] =
+	{
+		static_cast<uint8_t>(pulseOne * 17),
+		static_cast<uint8_t>(pulseTwo * 17),
+		static_cast<uint8_t>(triangle * 17),
+		static_cast<uint8_t>(noise * 17),
+		static_cast<uint8_t>(dmc * 2)
+	};
+
+	for (uint32_t i = 0; i < NUM_STEMS; ++i)
+	{
+		_writer.Write(_files[i], &samples[i], 1);
+	}
+
+	++_samplesRecorded;
+}
+
+void StemRecorder::Finish()
+{
+	if (_finished)
+	{
+		return;
+	}
+
+	_finished = true;
+	_writer.Close();
+
+	uint8_t header[WAV_HEADER_SIZE];
+	BuildWavHeader(header, WavSampleFormat::UnsignedByte, _sampleRate, 1, static_cast<uint32_t>(_samplesRecorded));
+
+	for (uint32_t i = 0; i < NUM_STEMS; ++i)
+	{
+		std::fstream file(_paths[i].c_str(), std::fstream::in | std::fstream::out | std::fstream::binary);
+		file.write(reinterpret_cast<const char*>(header), WAV_HEADER_SIZE);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "async_file_writer.h"
+
+// Records the output level of each APU channel to its own WAV file, to compare what the
+// channels do between builds. Levels are point sampled at a fixed rate with no filtering
+// and scaled up to 8-bit unsigned samples, so every level maps to exactly one sample
+// value and two recordings of the same output are byte for byte identical. Files are
+// written on a background thread.
+class StemRecorder
+{
+public:
+	// Records to <pathPrefix>_pulse1.wav, _pulse2.wav, _triangle.wav, _noise.wav and _dmc.wav
+	StemRecorder(const std::string& pathPrefix, uint32_t sampleRate);
+	~StemRecorder();
+
+	// Add one sample to each file. Takes the raw channel levels, 0-15 for all but the
+	// DMC which is 0-127.
+	void Record(uint8_t pulseOne, uint8_t pulseTwo, uint8_t triangle, uint8_t noise, uint8_t dmc);
+
+	// Write out anything still buffered and fill in the WAV headers
+	void Finish();
+
+private:
+	static constexpr uint32_t NUM_STEMS = 5;
+
+	AsyncFileWriter _writer;
+	std::string _paths[NUM_STEMS];
+	uint32_t _files[NUM_STEMS];
+	uint32_t _sampleRate;
+	uint64_t _samplesRecorded;
+	bool _finished;
+};
\ No newline at end of file
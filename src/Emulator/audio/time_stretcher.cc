@@ -0,0 +1,176 @@
+#include "time_stretcher.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TIME_STRETCHER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+constexpr double PI = 3.14159265358979323846;
+
+// Long enough to hold a few periods of the lowest notes, short enough that the echo
+// from overlapping frames isn't noticeable
+constexpr double FRAME_LENGTH = 0.024; // Seconds
+
+// About a period of a 250 Hz tone either way, enough to line up anything but the bass
+constexpr double SEARCH_LENGTH = 0.004; // Seconds
+
+constexpr double MIN_RATIO = 0.5;
+constexpr double MAX_RATIO = 8.0;
+}
+
+TimeStretcher::TimeStretcher(uint32_t sampleRate)
+	: _ratio(1.0)
+	, _nominalPosition(0.0)
+	, _previousPosition(0)
+	, _havePrevious(false)
+{
+	// Hop rounded to a multiple of 4 so the correlation works in whole SIMD lanes
+	_hopSize = std::max(static_cast<uint32_t>(sampleRate * FRAME_LENGTH / 2.0) & ~3U, 4U);
+	_searchRange = static_cast<uint32_t>(sampleRate * SEARCH_LENGTH);
+
+	// Periodic Hann window, two of them offset by half their length sum to exactly 1
+	uint32_t frameSize = _hopSize * 2;
+	_window.resize(frameSize);
+	for (uint32_t i = 0; i < frameSize; ++i)
+	{
+		_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * PI * i / frameSize));
+	}
+
+	Reset();
+}
+
+void TimeStretcher::SetRatio(double ratio)
+{
+	_ratio = std::max(MIN_RATIO, std::min(ratio, MAX_RATIO));
+}
+
+void TimeStretcher::Reset()
+{
+	_input.clear();
+	_overlap.assign(_hopSize, 0.0f);
+
+	// Start far enough in that the first search doesn't run off the front
+	_nominalPosition = _searchRange;
+	_previousPosition = 0;
+	_havePrevious = false;
+}
+
+void TimeStretcher::Process(const float* input, uint32_t count, std::vector<float>& output)
+{
+	output.clear();
+	_input.insert(_input.end(), input, input + count);
+
+	const size_t frameSize = _hopSize * 2;
+
+	while (true)
+	{
+		size_t nominal = static_cast<size_t>(_nominalPosition);
+		size_t searchStart = nominal - _searchRange;
+		size_t searchEnd = nominal + _searchRange;
+
+		if (searchEnd + frameSize > _input.size())
+		{
+			break;
+		}
+
+		size_t position = _havePrevious ? FindBestPosition(searchStart, searchEnd) : nominal;
+		const float* frame = &_input[position];
+
+		for (uint32_t i = 0; i < _hopSize; ++i)
+		{
+			output.push_back(_overlap[i] + frame[i] * _window[i]);
+			_overlap[i] = frame[_hopSize + i] * _window[_hopSize + i];
+		}
+
+		_previousPosition = position;
+		_havePrevious = true;
+		_nominalPosition += _hopSize * _ratio;
+	}
+
+	// Keep the continuation of the last frame, which the next search is matched against,
+	// and everything the next search could pick
+	size_t nextSearchStart = static_cast<size_t>(_nominalPosition) - _searchRange;
+	size_t discard = std::min(nextSearchStart, _havePrevious ? _previousPosition + _hopSize : nextSearchStart);
+	discard = std::min(discard, _input.size());
+
+	_input.erase(_input.begin(), _input.begin() + discard);
+	_nominalPosition -= discard;
+	_previousPosition -= _havePrevious ? discard : 0;
+}
+
+size_t TimeStretcher::FindBestPosition(size_t searchStart, size_t searchEnd)
+{
+	// Where the last frame's waveform would have carried on if it hadn't been cut off.
+	// The new frame's first half should look as much like it as possible.
+	size_t target = _previousPosition + _hopSize;
+
+	// Search every other offset, then check the two either side of the best one
+	size_t best = searchStart;
+	float bestScore = Correlate(searchStart, target);
+
+	for (size_t position = searchStart + 2; position <= searchEnd; position += 2)
+	{
+		float score = Correlate(position, target);
+		if (score > bestScore)
+		{
+			bestScore = score;
+			best = position;
+		}
+	}
+
+	size_t coarse = best;
+	if (coarse > searchStart)
+	{
+		float score = Correlate(coarse - 1, target);
+		if (score > bestScore)
+		{
+			bestScore = score;
+			best = coarse - 1;
+		}
+	}
+
+	if (coarse < searchEnd)
+	{
+		float score = Correlate(coarse + 1, target);
+		if (score > bestScore)
+		{
+			best = coarse + 1;
+		}
+	}
+
+	return best;
+}
+
+float TimeStretcher::Correlate(size_t position, size_t target)
+{
+	const float* a = &_input[position];
+	const float* b = &_input[target];
+
+#if defined(TIME_STRETCHER_SSE2)
+	__m128 sum = _mm_setzero_ps();
+	for (uint32_t i = 0; i < _hopSize; i += 4)
+	{
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+	}
+
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(sum);
+#else
+	float sums[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (uint32_t i = 0; i < _hopSize; i += 4)
+	{
+		for (uint32_t j = 0; j < 4; ++j)
+		{
+			sums[j] += a[i + j] * b[i + j];
+		}
+	}
+
+	return (sums[0] + sums[2]) + (sums[1] + sums[3]);
+#endif
+}
\ No newline at end of file
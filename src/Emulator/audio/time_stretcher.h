@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Changes the speed of a stream of samples without changing its pitch, using WSOLA
+// (waveform similarity overlap-add). The output is built from half overlapping,
+// Hann windowed frames of input. Each frame is taken from roughly where the input
+// should be at the chosen speed, nudged within a small range to wherever it best
+// lines up with the end of the frame before, so the waveforms add up in phase and
+// there's no warble.
+class TimeStretcher
+{
+public:
+	explicit TimeStretcher(uint32_t sampleRate);
+
+	// Input samples consumed per output sample, 2 plays back twice as fast. Can be
+	// changed at any time.
+	void SetRatio(double ratio);
+
+	// Drop all buffered input and output
+	void Reset();
+
+	// Add count input samples. output is replaced with however many output samples that
+	// completed, input is held back until there's enough to search a whole frame.
+	void Process(const float* input, uint32_t count, std::vector<float>& output);
+
+private:
+	size_t FindBestPosition(size_t searchStart, size_t searchEnd);
+	float Correlate(size_t position, size_t target);
+
+	uint32_t _hopSize;     // Output samples per frame, frames are twice this long
+	uint32_t _searchRange; // How far either side of the nominal position to look
+	double _ratio;
+
+	std::vector<float> _window;
+	std::vector<float> _input;
+	std::vector<float> _overlap; // Second half of the last frame, already windowed
+
+	double _nominalPosition;  // Where the next frame belongs in _input going by the ratio alone
+	size_t _previousPosition; // Where the last frame was taken from in _input
+	bool _havePrevious;
+};
\ No newline at end of file
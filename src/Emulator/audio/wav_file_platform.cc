@@ -0,0 +1,129 @@
+#include "wav_file_platform.h"
+#include "wav_header.h"
+#include "nes_exception.h"
+
+#include <cstring>
+#include <limits>
+
+namespace
+{
+constexpr size_t WRITE_BUFFER_SIZE = 64 * 1024;
+constexpr uint16_t BYTES_PER_SAMPLE = sizeof(float);
+}
+
+WavFilePlatform::WavFilePlatform(const std::string& path)
+	: _path(path)
+	, _sampleRate(0)
+	, _samplesWritten(0)
+{
+	_buffer.reserve(WRITE_BUFFER_SIZE);
+}
+
+void WavFilePlatform::Initialize(uint32_t sampleRate, uint32_t, uint32_t)
+{
+	_sampleRate = sampleRate;
+
+	// Reinitializing to change the latency carries on with the same file
+	if (_file.is_open())
+	{
+		return;
+	}
+
+	_file.open(_path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+	if (!_file.good())
+	{
+		throw NesException("WavFilePlatform", "Failed to open " + _path + " for writing");
+	}
+
+	// Written again with the real sizes once the file is finished
+	WriteHeader();
+}
+
+void WavFilePlatform::CleanUp()
+{
+	// Only called when the backend is torn down or reinitialized. Bring the header up to
+	// date either way so the file is valid even if nothing else is ever written.
+	if (!_file.is_open())
+	{
+		return;
+	}
+
+	Flush();
+
+	_file.seekp(0);
+	WriteHeader();
+	_file.seekp(0, std::ofstream::end);
+	_file.flush();
+}
+
+void WavFilePlatform::Reset()
+{
+}
+
+uint32_t WavFilePlatform::GetNumPendingSamples()
+{
+	return 0;
+}
+
+void WavFilePlatform::SubmitSamples(const float* samples, uint32_t count)
+{
+	// The data chunk size is 32 bits, stop once it's full rather than write a broken file
+	uint64_t maxSamples = (std::numeric_limits<uint32_t>::max() - WAV_HEADER_SIZE) / BYTES_PER_SAMPLE;
+	if (_samplesWritten + count > maxSamples)
+	{
+		count = static_cast<uint32_t>(maxSamples - _samplesWritten);
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t bits;
+		memcpy(&bits, &samples[i], sizeof(bits));
+
+		uint8_t bytes[BYTES_PER_SAMPLE];
+		PutLittleEndian32(bytes, bits);
+		_buffer.insert(_buffer.end(), bytes, bytes + BYTES_PER_SAMPLE);
+	}
+
+	_samplesWritten += count;
+
+	if (_buffer.size() >= WRITE_BUFFER_SIZE)
+	{
+		Flush();
+	}
+}
+
+uint32_t WavFilePlatform::GetSampleRate()
+{
+	return _sampleRate;
+}
+
+bool WavFilePlatform::IsRealTime()
+{
+	return false;
+}
+
+AudioStatistics WavFilePlatform::GetStatistics()
+{
+	AudioStatistics statistics = {};
+	statistics.queuedSamples = static_cast<uint32_t>(_buffer.size() / BYTES_PER_SAMPLE);
+	statistics.sampleRate = _sampleRate;
+
+	return statistics;
+}
+
+void WavFilePlatform::WriteHeader()
+{
+	uint8_t header[WAV_HEADER_SIZE];
+	BuildWavHeader(header, WavSampleFormat::Float, _sampleRate, 1, static_cast<uint32_t>(_samplesWritten * BYTES_PER_SAMPLE));
+
+	_file.write(reinterpret_cast<const char*>(header), WAV_HEADER_SIZE);
+}
+
+void WavFilePlatform::Flush()
+{
+	if (!_buffer.empty())
+	{
+		_file.write(_buffer.data(), _buffer.size());
+		_buffer.clear();
+	}
+}
\ No newline at end of file
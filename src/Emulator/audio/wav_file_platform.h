@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "iaudio_platform.h"
+
+// Writes samples to a WAV file instead of playing them. Samples are stored exactly as
+// submitted, as 32-bit float mono, so two runs producing the same audio produce the
+// same file. Writes are collected in a buffer and go to disk in large chunks.
+class WavFilePlatform : public IAudioPlatform
+{
+public:
+	explicit WavFilePlatform(const std::string& path);
+
+	virtual void Initialize(uint32_t sampleRate, uint32_t periodLength, uint32_t numPeriods) override;
+	virtual void CleanUp() override;
+	virtual void Reset() override;
+	virtual uint32_t GetNumPendingSamples() override;
+	virtual void SubmitSamples(const float* samples, uint32_t count) override;
+	virtual uint32_t GetSampleRate() override;
+	virtual bool IsRealTime() override;
+	virtual AudioStatistics GetStatistics() override;
+
+private:
+	void WriteHeader();
+	void Flush();
+
+	std::string _path;
+	std::ofstream _file;
+	uint32_t _sampleRate;
+	uint64_t _samplesWritten;
+	std::vector<char> _buffer;
+};
\ No newline at end of file
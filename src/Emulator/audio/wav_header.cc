@@ -0,0 +1,45 @@
+#include "wav_header.h"
+
+#include <cstring>
+
+namespace
+{
+constexpr uint16_t WAVE_FORMAT_PCM = 1;
+constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+}
+
+void PutLittleEndian16(uint8_t* out, uint16_t value)
+{
+	out[0] = static_cast<uint8_t>(value & 0xFF);
+	out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void PutLittleEndian32(uint8_t* out, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		out[i] = static_cast<uint8_t>((value >> (i * 8)) & 0xFF);
+	}
+}
+
+void BuildWavHeader(uint8_t* header, WavSampleFormat format, uint32_t sampleRate, uint16_t numChannels, uint32_t dataSize)
+{
+	uint16_t bytesPerSample = (format == WavSampleFormat::Float) ? 4 : 1;
+	uint16_t formatTag = (format == WavSampleFormat::Float) ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+
+	memcpy(header, "RIFF", 4);
+	PutLittleEndian32(header + 4, WAV_HEADER_SIZE - 8 + dataSize);
+	memcpy(header + 8, "WAVE", 4);
+
+	memcpy(header + 12, "fmt ", 4);
+	PutLittleEndian32(header + 16, 16);
+	PutLittleEndian16(header + 20, formatTag);
+	PutLittleEndian16(header + 22, numChannels);
+	PutLittleEndian32(header + 24, sampleRate);
+	PutLittleEndian32(header + 28, sampleRate * numChannels * bytesPerSample);
+	PutLittleEndian16(header + 32, numChannels * bytesPerSample);
+	PutLittleEndian16(header + 34, bytesPerSample * 8);
+
+	memcpy(header + 36, "data", 4);
+	PutLittleEndian32(header + 40, dataSize);
+}
\ No newline at end of file
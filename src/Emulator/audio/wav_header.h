@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// Canonical 44 byte header of a WAV file holding one data chunk
+constexpr uint32_t WAV_HEADER_SIZE = 44;
+
+enum class WavSampleFormat
+{
+	UnsignedByte, // 8-bit unsigned PCM
+	Float         // 32-bit IEEE float
+};
+
+// Fill in a header for dataSize bytes of samples. WAV is little endian whatever the host is.
+void BuildWavHeader(uint8_t* header, WavSampleFormat format, uint32_t sampleRate, uint16_t numChannels, uint32_t dataSize);
+
+// Store value into out as little endian
+void PutLittleEndian16(uint8_t* out, uint16_t value);
+void PutLittleEndian32(uint8_t* out, uint32_t value);
\ No newline at end of file
@@ -2,12 +2,13 @@
 
 #include "xaudio2_platform.h"
 #include "nes_exception.h"
+#include <algorithm>
+#include <cstring>
 #include <string>
 
 #pragma comment(lib, "XAudio2.lib")
 
-static constexpr uint32_t BUFFERS_PER_FRAME = 4;
-static constexpr uint32_t STANDARD_FRAME_RATE = 60;
+static constexpr uint32_t MIN_BUFFERS = 2;
 
 class XAudio2Platform::VoiceCallback : public IXAudio2VoiceCallback
 {
@@ -23,6 +24,7 @@ public:
 		if (_platform._writeIndex == _platform._readIndex && !_platform._overlapped)
 		{
 			_platform._xaudio2SourceVoice->Stop(0);
+			_platform._underruns++;
 		}
 		else
 		{
@@ -62,9 +64,11 @@ XAudio2Platform::XAudio2Platform()
 	, _readIndex(0)
 	, _overlapped(false)
 	, _outputBuffers(nullptr)
+	, _underruns(0)
+	, _buffersQueued(0)
 {}
 
-void XAudio2Platform::Initialize(uint32_t sampleRate)
+void XAudio2Platform::Initialize(uint32_t sampleRate, uint32_t periodLength, uint32_t numPeriods)
 {
 	_xaudio2Instance = nullptr;
 	_xaudio2MasteringVoice = nullptr;
@@ -72,11 +76,13 @@ void XAudio2Platform::Initialize(uint32_t sampleRate)
 	_voiceCallback = nullptr;
 	_currentBufferOffset = 0;
 	_sampleRate = sampleRate;
-	_bufferSize = _sampleRate / STANDARD_FRAME_RATE / BUFFERS_PER_FRAME;
+	_bufferSize = (std::max)((_sampleRate * periodLength) / 1000, 1U);
 	_writeIndex = 0;
 	_readIndex = 0;
 	_overlapped = false;
-	_numOutputBuffers = BUFFERS_PER_FRAME;
+	_numOutputBuffers = (std::max)(numPeriods, MIN_BUFFERS);
+	_underruns = 0;
+	_buffersQueued = 0;
 
 	WAVEFORMATEX WaveFormat = { 0 };
 	WaveFormat.nChannels = 1;
@@ -153,15 +159,26 @@ void XAudio2Platform::Reset()
 	return _currentBufferOffset;
 }
 
-void XAudio2Platform::SubmitSample(float sample)
+void XAudio2Platform::SubmitSamples(const float* samples, uint32_t count)
 {
 	std::unique_lock<std::mutex> lock(_mutex);
 
-	float* buffer = _outputBuffers[_writeIndex];
-	buffer[_currentBufferOffset++] = sample;
-
-	if (_currentBufferOffset == _bufferSize)
+	while (count > 0)
 	{
+		float* buffer = _outputBuffers[_writeIndex];
+
+		uint32_t copied = (std::min)(count, _bufferSize - _currentBufferOffset);
+		memcpy(buffer + _currentBufferOffset, samples, copied * sizeof(float));
+
+		_currentBufferOffset += copied;
+		samples += copied;
+		count -= copied;
+
+		if (_currentBufferOffset < _bufferSize)
+		{
+			break;
+		}
+
 		XAUDIO2_BUFFER xaudio2Buffer = { 0 };
 		xaudio2Buffer.AudioBytes = _currentBufferOffset * sizeof(float);
 		xaudio2Buffer.pAudioData = static_cast<BYTE*>(static_cast<void*>(buffer));
@@ -169,6 +186,8 @@ void XAudio2Platform::SubmitSample(float sample)
 
 		XAUDIO2_VOICE_STATE state;
 		_xaudio2SourceVoice->GetState(&state);
+		_buffersQueued = state.BuffersQueued;
+
 		if (state.BuffersQueued >= _numOutputBuffers - 1)
 		{
 			_xaudio2SourceVoice->Start(0);
@@ -181,12 +200,12 @@ void XAudio2Platform::SubmitSample(float sample)
 			_writeIndex = 0;
 		}
 
+		_currentBufferOffset = 0;
+
 		if (_writeIndex == _readIndex && _overlapped)
 		{
 			_cv.wait(lock);
 		}
-
-		_currentBufferOffset = 0;
 	}
 }
 
@@ -195,4 +214,27 @@ uint32_t XAudio2Platform::GetSampleRate()
 	return _sampleRate;
 }
 
+bool XAudio2Platform::IsRealTime()
+{
+	return true;
+}
+
+AudioStatistics XAudio2Platform::GetStatistics()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	// XAudio2 doesn't report the delay through the device, the queued buffers are the
+	// best there is
+	AudioStatistics statistics;
+	statistics.underruns = _underruns;
+	statistics.deviceDelay = _buffersQueued * _bufferSize;
+	statistics.deviceBufferFill = _buffersQueued * _bufferSize;
+	statistics.deviceBufferSize = _numOutputBuffers * _bufferSize;
+	statistics.queuedSamples = _currentBufferOffset;
+	statistics.periodSize = _bufferSize;
+	statistics.sampleRate = _sampleRate;
+
+	return statistics;
+}
+
 #endif
\ No newline at end of file
@@ -15,12 +15,14 @@ public:
 	XAudio2Platform();
 	virtual ~XAudio2Platform() {};
 
-	virtual void Initialize(uint32_t sampleRate) override;
+	virtual void Initialize(uint32_t sampleRate, uint32_t periodLength, uint32_t numPeriods) override;
 	virtual void CleanUp() override;
 	virtual void Reset() override;
 	virtual uint32_t GetNumPendingSamples() override;
-	virtual void SubmitSample(float sample) override;
+	virtual void SubmitSamples(const float* samples, uint32_t count) override;
 	virtual uint32_t GetSampleRate() override;
+	virtual bool IsRealTime() override;
+	virtual AudioStatistics GetStatistics() override;
 
 private:
 	class VoiceCallback;
@@ -40,6 +42,9 @@ private:
 	bool _overlapped;
 	float** _outputBuffers;
 
+	uint32_t _underruns;
+	uint32_t _buffersQueued;
+
 	std::mutex _mutex;
 	std::condition_variable _cv;
 };
@@ -0,0 +1,135 @@
+#include <cstring>
+
+#include "async_file_writer.h"
+#include "nes_exception.h"
+
+namespace
+{
+    // Big enough that the writer thread is woken rarely, small enough to not matter
+    // when a handful of files are open at once
+    constexpr size_t BUFFER_SIZE = 64 * 1024;
+}
+
+AsyncFileWriter::AsyncFileWriter()
+    : _closing(false)
+{
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+    Close();
+}
+
+uint32_t AsyncFileWriter::Open(const std::string& path)
+{
+    std::unique_ptr<std::ofstream> file(new std::ofstream(path.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc));
+    if (!file->good())
+    {
+        throw NesException("AsyncFileWriter", "Failed to open " + path + " for writing");
+    }
+
+    _files.push_back(std::move(file));
+    _buffers.emplace_back();
+    _buffers.back().reserve(BUFFER_SIZE);
+
+    return static_cast<uint32_t>(_files.size() - 1);
+}
+
+void AsyncFileWriter::Write(uint32_t file, const void* data, size_t size)
+{
+    std::vector<char>& buffer = _buffers[file];
+
+    const char* bytes = static_cast<const char*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+
+    if (buffer.size() >= BUFFER_SIZE)
+    {
+        Submit(file);
+    }
+}
+
+void AsyncFileWriter::Close()
+{
+    for (uint32_t i = 0; i < _buffers.size(); ++i)
+    {
+        if (!_buffers[i].empty())
+        {
+            Submit(i);
+        }
+    }
+
+    if (_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closing = true;
+        }
+
+        _cv.notify_one();
+        _thread.join();
+    }
+
+    for (std::unique_ptr<std::ofstream>& file : _files)
+    {
+        file->close();
+    }
+
+    _files.clear();
+    _buffers.clear();
+}
+
+void AsyncFileWriter::Submit(uint32_t file)
+{
+    // Started on the first full buffer, after which the list of files can't change
+    if (!_thread.joinable())
+    {
+        _closing = false;
+        _thread = std::thread(&AsyncFileWriter::WriterLoop, this);
+    }
+
+    Chunk chunk;
+    chunk.file = file;
+    chunk.data.swap(_buffers[file]);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(std::move(chunk));
+
+        if (!_freeBuffers.empty())
+        {
+            _buffers[file].swap(_freeBuffers.back());
+            _freeBuffers.pop_back();
+        }
+    }
+
+    _cv.notify_one();
+
+    // Only allocates when no buffer came back from the writer
+    _buffers[file].reserve(BUFFER_SIZE);
+}
+
+void AsyncFileWriter::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _cv.wait(lock, [this]() { return _closing || !_queue.empty(); });
+
+        if (_queue.empty())
+        {
+            break;
+        }
+
+        Chunk chunk = std::move(_queue.front());
+        _queue.pop_front();
+
+        lock.unlock();
+
+        _files[chunk.file]->write(chunk.data.data(), chunk.data.size());
+        chunk.data.clear();
+
+        lock.lock();
+        _freeBuffers.push_back(std::move(chunk.data));
+    }
+}
\ No newline at end of file
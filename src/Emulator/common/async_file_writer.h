@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Appends to a set of files from a background thread, so the thread producing the
+ * data never waits on the disk.
+ *
+ * Writes are collected into a buffer per file, and whenever a buffer fills it is
+ * handed to the writer thread. Buffers the writer is done with are reused. If the
+ * writer falls behind, more buffers are allocated rather than making the producer
+ * wait.
+ *
+ * Open and Write are only called from the producing thread.
+ */
+class AsyncFileWriter
+{
+public:
+    AsyncFileWriter();
+    ~AsyncFileWriter();
+
+    // Create or truncate a file and return the index to pass to Write. Throws NesException
+    // if the file can't be opened. All files have to be opened before the first Write.
+    uint32_t Open(const std::string& path);
+
+    // Queue data to be appended to a file
+    void Write(uint32_t file, const void* data, size_t size);
+
+    // Wait for everything written so far to reach the files, then close them
+    void Close();
+
+private:
+    struct Chunk
+    {
+        uint32_t file;
+        std::vector<char> data;
+    };
+
+    void WriterLoop();
+    void Submit(uint32_t file);
+
+    std::vector<std::unique_ptr<std::ofstream> > _files; // Only touched by the writer thread while it's running
+    std::vector<std::vector<char> > _buffers;           // Buffer currently being filled for each file
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<Chunk> _queue;
+    std::vector<std::vector<char> > _freeBuffers;
+    bool _closing;
+
+    std::thread _thread;
+};
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <thread>
+
+#include "frame_pacer.h"
+
+namespace
+{
+    constexpr double NATIVE_FRAME_RATE = 60.0988;
+
+    // How much faster than the target to run when audio is the master clock
+    constexpr double AUDIO_SYNC_MARGIN = 1.005;
+
+    // How many frames behind schedule we can get before giving up on catching up
+    constexpr int MAX_FRAMES_BEHIND = 2;
+
+    // Extra time left for spinning on top of the measured jitter
+    constexpr std::chrono::microseconds SPIN_MARGIN(200);
+    constexpr std::chrono::microseconds INITIAL_JITTER(1000);
+}
+
+FramePacer::FramePacer()
+    : _targetFrameRate(60)
+    , _audioSyncEnabled(false)
+    , _currentFrameRate(0)
+    , _currentAudioSync(false)
+    , _frameInterval(0)
+    , _nextFrame(Clock::now())
+    , _sleepJitter(INITIAL_JITTER)
+{
+    UpdateFrameInterval();
+}
+
+void FramePacer::SetTargetFrameRate(uint32_t rate)
+{
+    _targetFrameRate = std::min(std::max(rate, 20U), 240U);
+}
+
+void FramePacer::SetAudioSyncEnabled(bool enabled)
+{
+    _audioSyncEnabled = enabled;
+}
+
+void FramePacer::WaitForNextFrame()
+{
+    if (_currentFrameRate != _targetFrameRate || _currentAudioSync != _audioSyncEnabled)
+    {
+        UpdateFrameInterval();
+    }
+
+    Clock::time_point now = Clock::now();
+
+    _nextFrame += _frameInterval;
+
+    if (now >= _nextFrame)
+    {
+        if (now - _nextFrame > _frameInterval * MAX_FRAMES_BEHIND)
+        {
+            _nextFrame = now;
+        }
+
+        return;
+    }
+
+    SleepUntil(_nextFrame);
+}
+
+void FramePacer::UpdateFrameInterval()
+{
+    using namespace std::chrono;
+
+    _currentFrameRate = _targetFrameRate;
+    _currentAudioSync = _audioSyncEnabled;
+
+    double frameRate = NATIVE_FRAME_RATE * (_currentFrameRate / 60.0);
+    if (_currentAudioSync)
+    {
+        frameRate *= AUDIO_SYNC_MARGIN;
+    }
+
+    _frameInterval = duration_cast<Clock::duration>(duration<double>(1.0 / frameRate));
+}
+
+void FramePacer::SleepUntil(Clock::time_point deadline)
+{
+    Clock::time_point now = Clock::now();
+    Clock::duration sleepTime = (deadline - now) - _sleepJitter - SPIN_MARGIN;
+
+    if (sleepTime > Clock::duration::zero())
+    {
+        std::this_thread::sleep_for(sleepTime);
+
+        Clock::time_point woke = Clock::now();
+        Clock::duration overshoot = std::max((woke - now) - sleepTime, Clock::duration::zero());
+
+        // Rise quickly after a long sleep so the next deadline isn't missed, decay slowly
+        if (overshoot > _sleepJitter)
+        {
+            _sleepJitter = (_sleepJitter + overshoot) / 2;
+        }
+        else
+        {
+            _sleepJitter -= (_sleepJitter - overshoot) / 16;
+        }
+    }
+
+    while (Clock::now() < deadline)
+    {
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/*
+ * Paces emulation to a target frame rate on the steady clock.
+ *
+ * Most of the wait is spent asleep, but the OS only guarantees a sleep lasts at
+ * least as long as requested. The pacer keeps a running estimate of how far
+ * past its deadline a sleep tends to run and wakes up that much early, then
+ * spins for the remainder.
+ *
+ * When audio is enabled the audio device stays the master clock. The pacer runs
+ * slightly faster than the target so the audio buffers still fill and block as
+ * usual, and the pacer only smooths out bursts in between.
+ */
+class FramePacer
+{
+public:
+    FramePacer();
+
+    // Frame rate relative to a nominal 60 fps, a rate of 60 runs at the native NTSC rate
+    void SetTargetFrameRate(uint32_t rate);
+    void SetAudioSyncEnabled(bool enabled);
+
+    // Block until the next frame is due. If emulation has fallen more than a couple of
+    // frames behind (paused, turbo mode, a slow host) the schedule restarts from now
+    // rather than running fast to catch up.
+    void WaitForNextFrame();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void UpdateFrameInterval();
+    void SleepUntil(Clock::time_point deadline);
+
+    std::atomic<uint32_t> _targetFrameRate;
+    std::atomic<bool> _audioSyncEnabled;
+
+    uint32_t _currentFrameRate;
+    bool _currentAudioSync;
+
+    Clock::duration _frameInterval;
+    Clock::time_point _nextFrame;
+
+    // Running estimate of how long sleeps overshoot by
+    Clock::duration _sleepJitter;
+};
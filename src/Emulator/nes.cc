@@ -19,7 +19,9 @@
 #include "audio/audio_backend.h"
 
 NES::NES(const std::string& gamePath, const std::string& savePath,
-            void* windowHandle, NESCallback* callback)
+            void* windowHandle, NESCallback* callback,
+            AudioOutput audioOutput, const std::string& audioOutputPath,
+            uint32_t offscreenWidth, uint32_t offscreenHeight)
     : Apu(nullptr)
     , Cpu(nullptr)
     , Ppu(nullptr)
@@ -27,6 +29,9 @@ NES::NES(const std::string& gamePath, const std::string& savePath,
     , VideoOut(nullptr)
     , AudioOut(nullptr)
     , Callback(callback)
+    , TargetFrameRate(60)
+    , AudioPeriodLength(AudioBackend::DEFAULT_PERIOD_LENGTH)
+    , AudioPeriods(AudioBackend::DEFAULT_NUM_PERIODS)
 {
     try
     {
@@ -34,11 +39,16 @@ NES::NES(const std::string& gamePath, const std::string& savePath,
         {
             VideoOut = new VideoBackend(windowHandle);
         }
+        else if (offscreenWidth != 0 && offscreenHeight != 0)
+        {
+            VideoOut = new VideoBackend(nullptr);
+            VideoOut->SetOffscreenSurfaceSize(offscreenWidth, offscreenHeight);
+        }
 
-        AudioOut = new AudioBackend();
+        AudioOut = new AudioBackend(audioOutput, audioOutputPath);
         
         Cpu = new CPU;
-        Ppu = new PPU(VideoOut, Callback); // Will be nullptr in HeadlessMode
+        Ppu = new PPU(VideoOut, Callback); // Will be nullptr when nothing is drawn
         Apu = new APU(AudioOut);
         Cartridge = new Cart(gamePath);
         Cartridge->SetSaveDirectory(savePath);
@@ -81,9 +91,11 @@ NES::NES(const std::string& gamePath, const std::string& savePath,
     // PPU Settings
     Ppu->SetTurboModeEnabled(false);
     Ppu->SetNtscDecodingEnabled(false);
+    Ppu->SetAudioSyncEnabled(AudioOut->IsRealTime());
 
     // APU Settings
     Apu->SetTurboModeEnabled(false);
+    Apu->SetMaxSpeedModeEnabled(false);
     Apu->SetAudioEnabled(true);
     Apu->SetMasterVolume(1.f);
     Apu->SetPulseOneVolume(1.f);
@@ -136,9 +148,27 @@ void NES::SetStateSaveDirectory(const std::string& saveDir)
     StateSaveDirectory = saveDir;
 }
 
+void NES::SetShaderCacheDirectory(const std::string& cacheDir)
+{
+    if (VideoOut != nullptr)
+    {
+        VideoOut->SetShaderCacheDirectory(cacheDir);
+    }
+}
+
 void NES::SetTargetFrameRate(uint32_t rate)
 {
+    TargetFrameRate = rate;
+
+    Ppu->SetTargetFrameRate(rate);
     Apu->SetTargetFrameRate(rate);
+
+    if (VideoOut != nullptr)
+    {
+        // Changing the rate can move it in or out of reach of the display's refresh
+        VideoOut->SetTargetFrameRate(rate);
+        Apu->SetDynamicRateControlEnabled(VideoOut->IsVsyncActive());
+    }
 }
 
 void NES::SetTurboModeEnabled(bool enabled)
@@ -147,11 +177,34 @@ void NES::SetTurboModeEnabled(bool enabled)
     Apu->SetTurboModeEnabled(enabled);
 }
 
+void NES::SetTurboFrameSkip(int frames)
+{
+    Ppu->SetTurboFrameSkip(frames);
+}
+
+void NES::SetMaxSpeedModeEnabled(bool enabled)
+{
+    // Audio output is what normally paces the emulator, so nothing is mixed at all
+    // rather than fast forwarded like in turbo mode
+    Ppu->SetMaxSpeedModeEnabled(enabled);
+    Apu->SetMaxSpeedModeEnabled(enabled);
+}
+
+void NES::SetMaxSpeedPresentRate(uint32_t presentRate)
+{
+    Ppu->SetMaxSpeedPresentRate(presentRate);
+}
+
 int NES::GetFrameRate()
 {
     return Ppu->GetFrameRate();
 }
 
+float NES::GetSpeedMultiplier()
+{
+    return Ppu->GetSpeedMultiplier();
+}
+
 void NES::GetNameTable(int table, uint8_t* pixels)
 {
     Ppu->GetNameTable(table, pixels);
@@ -177,23 +230,67 @@ void NES::SetNtscDecoderEnabled(bool enabled)
     Ppu->SetNtscDecodingEnabled(enabled);
 }
 
+void NES::SetGpuPaletteEnabled(bool enabled)
+{
+    Ppu->SetGpuPaletteEnabled(enabled);
+}
+
 void NES::SetFpsDisplayEnabled(bool enabled)
 {
-    VideoOut->ShowFps(enabled);
+    if (VideoOut != nullptr)
+    {
+        VideoOut->ShowFps(enabled);
+    }
+}
+
+void NES::SetSoftwareRenderingEnabled(bool enabled)
+{
+    if (VideoOut != nullptr)
+    {
+        VideoOut->SetSoftwareRenderingEnabled(enabled);
+    }
+}
+
+void NES::SetVsyncEnabled(bool enabled)
+{
+    if (VideoOut != nullptr)
+    {
+        VideoOut->SetVsyncEnabled(enabled);
+    }
 }
 
 void NES::SetOverscanEnabled(bool enabled)
 {
-    VideoOut->SetOverscanEnabled(enabled);
+    if (VideoOut != nullptr)
+    {
+        VideoOut->SetOverscanEnabled(enabled);
+    }
 }
 
 void NES::ShowMessage(const std::string& message, uint32_t duration)
 {
-    VideoOut->ShowMessage(message, duration);
+    if (VideoOut != nullptr)
+    {
+        VideoOut->ShowMessage(message, duration);
+    }
+}
+
+bool NES::ReadPresentedFrame(std::vector<uint32_t>& pixels, uint32_t* width, uint32_t* height)
+{
+    if (VideoOut == nullptr)
+    {
+        return false;
+    }
+
+    return VideoOut->ReadPresentedFrame(pixels, width, height);
 }
 
 void NES::SetAudioEnabled(bool enabled)
 {
+    // With audio on the output device has the final say on timing, otherwise the
+    // frame pacer alone keeps the emulator at the target frame rate. Outputs that
+    // don't play anything never hold emulation back.
+    Ppu->SetAudioSyncEnabled(enabled && AudioOut->IsRealTime());
     Apu->SetAudioEnabled(enabled);
 }
 
@@ -202,6 +299,22 @@ void NES::SetMasterVolume(float volume)
     Apu->SetMasterVolume(volume);
 }
 
+void NES::SetAudioLatency(uint32_t periodLength, uint32_t numPeriods)
+{
+    AudioPeriodLength = periodLength;
+    AudioPeriods = numPeriods;
+}
+
+void NES::SetAudioStemCapture(const std::string& pathPrefix)
+{
+    StemCapturePrefix = pathPrefix;
+}
+
+AudioStatistics NES::GetAudioStatistics()
+{
+    return AudioOut->GetStatistics();
+}
+
 void NES::SetPulseOneVolume(float volume)
 {
     Apu->SetPulseOneVolume(volume);
@@ -273,14 +386,40 @@ void NES::Run()
 {
     try
     {
-		VideoOut->Prepare();
+        if (VideoOut != nullptr)
+        {
+            VideoOut->Prepare();
+
+            // When frames are paced by the display the audio has to follow along, which
+            // can only be known once the renderer is up
+            Apu->SetDynamicRateControlEnabled(VideoOut->IsVsyncActive());
+        }
+
+        AudioOut->Open(AudioPeriodLength, AudioPeriods);
+
+        // The device can settle on a different sample rate than it was asked for, so
+        // the mixer has to be set up for the one it actually has
+        Apu->SetTargetFrameRate(TargetFrameRate);
+
+        if (!StemCapturePrefix.empty())
+        {
+            Apu->StartStemCapture(StemCapturePrefix);
+        }
+
         Cartridge->LoadNativeSave();
 
         CurrentState = State::Running;
         Cpu->Run();
 
+        // Emulation is over, finish off any stems while nothing is recording into them
+        Apu->StopStemCapture();
+
         Cartridge->SaveNativeSave();
-		VideoOut->Finalize();
+
+        if (VideoOut != nullptr)
+        {
+            VideoOut->Finalize();
+        }
     }
     catch (NesException&)
     {
@@ -368,7 +507,7 @@ void NES::SaveState(int slot)
     saveStream.write(reinterpret_cast<char*>(&componentStateSize), sizeof(size_t));
     saveStream.write(componentState->GetBuffer(), componentStateSize);
 
-    VideoOut->ShowMessage("Saved State " + std::to_string(slot), 5);
+    ShowMessage("Saved State " + std::to_string(slot), 5);
 
     Resume();
 }
@@ -414,7 +553,7 @@ void NES::LoadState(int slot)
 
     Cartridge->LoadState(StateSave::New(componentState, componentStateSize));
 
-    VideoOut->ShowMessage("Loaded State " + std::to_string(slot), 5);
+    ShowMessage("Loaded State " + std::to_string(slot), 5);
 
     Resume();
 }
@@ -8,11 +8,14 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "common/nes_callback.h"
 #include "common/nes_exception.h"
+#include "audio/iaudio_platform.h"
 
 class CPU;
 class APU;
@@ -24,8 +27,15 @@ class AudioBackend;
 class NES
 {
 public:
+    // audioOutputPath is the file written to when audioOutput is AudioOutput::WavFile.
+    //
+    // With no window, a non-zero offscreenWidth and offscreenHeight still render every
+    // frame, to an offscreen surface of that size that can be read back with
+    // ReadPresentedFrame. Otherwise nothing is drawn at all.
     NES(const std::string& gamePath, const std::string& nativeSavePath = "",
-            void* windowHandle = nullptr, NESCallback* callback = nullptr);
+            void* windowHandle = nullptr, NESCallback* callback = nullptr,
+            AudioOutput audioOutput = AudioOutput::Device, const std::string& audioOutputPath = "",
+            uint32_t offscreenWidth = 0, uint32_t offscreenHeight = 0);
     ~NES();
 
     enum State
@@ -47,24 +57,49 @@ public:
     void SetCpuLogEnabled(bool enabled);
     void SetNativeSaveDirectory(const std::string& saveDir);
     void SetStateSaveDirectory(const std::string& saveDir);
+    void SetShaderCacheDirectory(const std::string& cacheDir);
 
     void SetTargetFrameRate(uint32_t rate);
     void SetTurboModeEnabled(bool enabled);
+    void SetTurboFrameSkip(int frames);
+
+    // Run the emulator as fast as possible with audio muted. If presentRate is
+    // non-zero, at most that many frames per second are drawn and presented.
+    void SetMaxSpeedModeEnabled(bool enabled);
+    void SetMaxSpeedPresentRate(uint32_t presentRate);
 
     int GetFrameRate();
+    float GetSpeedMultiplier();
     void GetNameTable(int table, uint8_t* pixels);
     void GetPatternTable(int table, int palette, uint8_t* pixels);
     void GetPalette(int palette, uint8_t* pixels);
     void GetSprite(int sprite, uint8_t* pixels);
     void SetNtscDecoderEnabled(bool enabled);
+    void SetGpuPaletteEnabled(bool enabled);
+    void SetSoftwareRenderingEnabled(bool enabled); // Only takes effect if called before Start
+    void SetVsyncEnabled(bool enabled); // Only takes effect if called before Start
     void SetFpsDisplayEnabled(bool enabled);
     void SetOverscanEnabled(bool enabled);
 
     void ShowMessage(const std::string& message, uint32_t duration);
 
+    // Wait for the next frame presented to the offscreen surface and copy it out as
+    // 0x00RRGGBB pixels, top row first. Returns false when rendering offscreen wasn't
+    // asked for or no frame turned up.
+    bool ReadPresentedFrame(std::vector<uint32_t>& pixels, uint32_t* width, uint32_t* height);
+
     void SetAudioEnabled(bool enabled);
     void SetMasterVolume(float volume);
 
+    // Period length in milliseconds and number of periods in the audio device's buffer.
+    // Only takes effect if called before Start.
+    void SetAudioLatency(uint32_t periodLength, uint32_t numPeriods);
+
+    // Record each APU channel to <pathPrefix>_<channel>.wav for the whole run, empty to
+    // not record. Only takes effect if called before Start.
+    void SetAudioStemCapture(const std::string& pathPrefix);
+    AudioStatistics GetAudioStatistics();
+
     void SetPulseOneVolume(float volume);
     float GetPulseOneVolume();
     void SetPulseTwoVolume(float volume);
@@ -108,4 +143,13 @@ private:
     AudioBackend* AudioOut;
 
     NESCallback* Callback;
+
+    uint32_t TargetFrameRate;
+
+    // The audio output is opened once by Run with these, before emulation starts
+    uint32_t AudioPeriodLength;
+    uint32_t AudioPeriods;
+
+    // Also started by Run, the mixer records into the stems on the emulation thread
+    std::string StemCapturePrefix;
 };
@@ -5,6 +5,7 @@
  *      Author: Dale
  */
 
+#include <algorithm>
 #include <cstring>
 #include "ppu.h"
 #include "cpu.h"
@@ -20,6 +21,11 @@ static constexpr uint32_t RgbLookupTable[64] =
 };
 
 static constexpr uint32_t ResetDelay = 88974;
+static constexpr float NativeFrameRate = 60.0988f;
+
+// FNV-1a parameters, the hash is only used to spot rows that changed between frames
+static constexpr uint64_t RowHashBasis = 0xCBF29CE484222325ULL;
+static constexpr uint64_t RowHashPrime = 0x100000001B3ULL;
 
 PPU::PPU(VideoBackend* vout, NESCallback* callback)
     : Cpu(nullptr)
@@ -32,6 +38,11 @@ PPU::PPU(VideoBackend* vout, NESCallback* callback)
     , RequestTurboMode(false)
     , TurboModeEnabled(false)
     , TurboFrameSkip(0)
+    , TurboFramesToSkip(20)
+    , RequestMaxSpeedMode(false)
+    , MaxSpeedModeEnabled(false)
+    , MaxSpeedPresentRate(60)
+    , LastPresentTime(std::chrono::steady_clock::now())
     , Clock(0)
     , Dot(1)
     , Line(241)
@@ -75,7 +86,13 @@ PPU::PPU(VideoBackend* vout, NESCallback* callback)
     , BackgroundAttribute(0)
     , SpriteCount(0)
 	, FrameBufferIndex(0)
+    , FrameBuffer(vout != nullptr ? vout->GetFrameBuffer() : nullptr)
+    , RowHash(RowHashBasis)
     , NtscMode(false)
+    , GpuPaletteMode(false)
+    , RequestGpuPaletteMode(false)
+    , NtscFramePhase(0)
+    , NtscPixels(new uint16_t[256 * 240]())
 {
     memset(NameTable0, 0, sizeof(uint8_t) * 0x400);
     memset(NameTable1, 0, sizeof(uint8_t) * 0x400);
@@ -86,6 +103,12 @@ PPU::PPU(VideoBackend* vout, NESCallback* callback)
     memset(SpriteShift1, 0, sizeof(uint8_t) * 8);
     memset(SpriteAttribute, 0, sizeof(uint8_t) * 8);
     memset(SpriteCounter, 0, sizeof(uint8_t) * 8);
+    memset(RowHashes, 0, sizeof(RowHashes));
+
+    if (VideoOut != nullptr)
+    {
+        VideoOut->SetPalette(RgbLookupTable);
+    }
 }
 
 PPU::~PPU() {}
@@ -160,6 +183,13 @@ void PPU::Step()
             NmiOccuredFlag = false;
             InterruptActive = false;
             SpriteZeroHitFlag = false;
+
+            // Picked up fresh every frame since the backend moves its buffers into mapped GPU
+            // memory once the render thread is running
+            if (VideoOut != nullptr)
+            {
+                FrameBuffer = VideoOut->GetFrameBuffer();
+            }
         }
 
         if (RenderingEnabled)
@@ -408,20 +438,21 @@ void PPU::Step()
 
             if (Dot >= 1 && Dot <= 256)
             {
-                //if (TurboFrameSkip == 0)
+                if (TurboFrameSkip == 0)
                 {
                     RenderPixel();
                 }
+                else
+                {
+                    RenderPixelSkipped();
+                }
             }
         }
         else
         {
-            if (Dot >= 1 && Dot <= 256)
+            if (Dot >= 1 && Dot <= 256 && TurboFrameSkip == 0)
             {
-                //if (TurboFrameSkip == 0)
-                {
-                    RenderPixelIdle();
-                }
+                RenderPixelIdle();
             }
         }
 
@@ -431,6 +462,14 @@ void PPU::Step()
             // Toggle even flag
             Even = !Even;
 
+            // Make sure any NTSC lines still being decoded have landed in the frame buffer
+            Ntsc.WaitForLines();
+
+            // Only frames that were actually drawn get presented
+            bool frameRendered = TurboFrameSkip == 0;
+            bool ntscFrame = NtscMode && !TurboModeEnabled;
+            bool gpuFrame = GpuPaletteMode;
+
             UpdateFrameSkipCounters();
 
             // Update frame rate counter
@@ -439,14 +478,41 @@ void PPU::Step()
             // Check if a change in rendering mode or turbo mode has been requested
             MaybeChangeModes();
 
-            if (TurboFrameSkip == 0) {
-                VideoOut->SubmitFrame(reinterpret_cast<uint8_t*>(FrameBuffer));
+            if (frameRendered) {
+                LastPresentTime = std::chrono::steady_clock::now();
+
+                if (VideoOut != nullptr)
+                {
+                    VideoBackend::FrameFormat format = VideoBackend::FrameFormat::Bgra;
+                    if (gpuFrame)
+                    {
+                        format = ntscFrame ? VideoBackend::FrameFormat::NtscIndex : VideoBackend::FrameFormat::PaletteIndex;
+                    }
+
+                    VideoOut->SubmitFrame(format, NtscFramePhase, RowHashes);
+                }
+
                 FrameBufferIndex = 0;
 
                 if (Callback != nullptr) {
                     Callback->OnFrameComplete();
                 }
             }
+
+            // Turbo and max speed modes are deliberately unthrottled. With vsync on a
+            // display refreshing close to the target rate, the refresh sets the pace and
+            // the audio is resampled to match. Any other display is left to the pacer.
+            if (!TurboModeEnabled && !MaxSpeedModeEnabled)
+            {
+                if (VideoOut != nullptr && VideoOut->IsVsyncActive())
+                {
+                    VideoOut->WaitForVsync();
+                }
+                else
+                {
+                    Pacer.WaitForNextFrame();
+                }
+            }
         }
 
         if (Dot == 340)
@@ -515,11 +581,41 @@ void PPU::SetTurboModeEnabled(bool enabled)
     RequestTurboMode = enabled;
 }
 
+void PPU::SetTurboFrameSkip(int frames)
+{
+    TurboFramesToSkip = std::max(frames, 0);
+}
+
+void PPU::SetMaxSpeedModeEnabled(bool enabled)
+{
+    RequestMaxSpeedMode = enabled;
+}
+
+void PPU::SetMaxSpeedPresentRate(uint32_t rate)
+{
+    MaxSpeedPresentRate = rate;
+}
+
+void PPU::SetTargetFrameRate(uint32_t rate)
+{
+    Pacer.SetTargetFrameRate(rate);
+}
+
+void PPU::SetAudioSyncEnabled(bool enabled)
+{
+    Pacer.SetAudioSyncEnabled(enabled);
+}
+
 void PPU::SetNtscDecodingEnabled(bool enabled)
 {
     RequestNtscMode = enabled;
 }
 
+void PPU::SetGpuPaletteEnabled(bool enabled)
+{
+    RequestGpuPaletteMode = enabled;
+}
+
 uint8_t PPU::ReadPPUStatus()
 {
     uint8_t vB = static_cast<uint8_t>(NmiOccuredFlag);
@@ -662,6 +758,11 @@ int PPU::GetFrameRate()
     return CurrentFps;
 }
 
+float PPU::GetSpeedMultiplier()
+{
+    return CurrentFps / NativeFrameRate;
+}
+
 void PPU::GetNameTable(int table, uint8_t* pixels)
 {
     uint16_t tableIndex;
@@ -1009,92 +1110,46 @@ void PPU::WriteNameTable1(uint8_t M, uint16_t address)
 
 void PPU::RenderNtscPixel(int pixel)
 {
-    static constexpr float levels[16] =
+    if (GpuPaletteMode)
     {
-        // Normal Levels
-          -0.116f / 12.f, 0.000f / 12.f, 0.307f / 12.f, 0.714f / 12.f,
-           0.399f / 12.f, 0.684f / 12.f, 1.000f / 12.f, 1.000f / 12.f,
-           // Attenuated Levels
-          -0.087f / 12.f, 0.000f / 12.f, 0.229f / 12.f, 0.532f / 12.f,
-           0.298f / 12.f, 0.510f / 12.f, 0.746f / 12.f, 0.746f / 12.f
-    };
-
-    auto SignalLevel = [=](int phase)
-    {
-        // Decode the NES color.
-        int color = (pixel & 0x0F);    // 0..15 "cccc"
-        int level = (pixel >> 4) & 3;  // 0..3  "ll"
-        int emphasis = (pixel >> 6);   // 0..7  "eee"
-        if (color > 13) { level = 1; } // For colors 14..15, level 1 is forced.
-
-                                       // The square wave for this color alternates between these two voltages:
-        int low = level;
-        int high = level + 4;
-
-        if (color == 0) { low = high; } // For color 0, only high level is emitted
-        if (color > 12) { high = low; } // For colors 13..15, only low level is emitted
-
-         // Generate the square wave
-        auto InColorPhase = [=](int color) { return (color + phase) % 12 < 6; }; // Inline function
-        int index = InColorPhase(color) ? high : low;
-
-        // When de-emphasis bits are set, some parts of the signal are attenuated:
-        if (((emphasis & 1) && InColorPhase(0)) || ((emphasis & 2) && InColorPhase(4)) || ((emphasis & 4) && InColorPhase(8)))
-        {
-            return levels[index + 8];
-        }
-        else
+        // The video backend decodes the signal, so the raw pixel goes straight into the frame
+        if (VideoOut != nullptr)
         {
-            return levels[index];
+            reinterpret_cast<uint16_t*>(FrameBuffer)[FrameBufferIndex++] = static_cast<uint16_t>(pixel);
         }
-    };
 
-    int phase = (Clock << 3) % 12;
-    for (int p = 0; p < 8; ++p) // Each pixel produces distinct 8 samples of NTSC signal.
-    {
-        int index = ((Dot - 1) << 3) + p;
-        SignalLevels[index] = SignalLevel((phase + p) % 12);
+        return;
     }
+
+    // Only the raw pixel is recorded here, the signal is decoded a line at a time
+    NtscPixels[(Line * 256) + (Dot - 1)] = static_cast<uint16_t>(pixel);
 }
 
 void PPU::RenderNtscLine()
 {
-    static constexpr int width = 256;
-    static constexpr float sineTable[12] =
-    {
-        0.89101f,  0.54464f,  0.05234f, -0.45399f, -0.83867f, -0.99863f,
-       -0.89101f, -0.54464f, -0.05234f,  0.45399f,  0.83867f,  0.99863f
-    };
+    // Colour carrier phase of the first pixel on the line
+    uint32_t phase = ((Clock - 255) << 3) % 12;
 
-    int phase = ((Clock - width + 1) << 3) % 12;
-
-    for (unsigned int x = 0; x < width; ++x)
+    if (GpuPaletteMode)
     {
-        // Determine the region of scanline signal to sample. Take 12 samples.
-        int center = ((x * width * 8) / width) + 4;
-        int begin = center - 6; if (begin < 0) begin = 0;
-        int end = center + 6; if (end > (width << 3)) end = (width << 3);
-        float y = 0.f, i = 0.f, q = 0.f; // Calculate the color in YIQ.
-        for (int p = begin; p < end; ++p) // Collect and accumulate samples
+        // Every line after the first is one step further along the carrier, so the
+        // backend only needs the phase of the first one
+        if (Line == 0)
         {
-            float level = SignalLevels[p];
-            y = y + level;
-            i = i + level * sineTable[(phase + p + 3) % 12];
-            q = q + level * sineTable[(phase + p) % 12];
+            NtscFramePhase = phase;
         }
 
-        auto clamp = [](float v) { return (v > 255.0f) ? 255.0f : ((v < 0.0f) ? 0.0f : v); };
+        return;
+    }
 
-        int red = static_cast<int>(clamp(255.95f * (y + 0.946882f*i + 0.623557f*q)));
-        int green = static_cast<int>(clamp(255.95f * (y + -0.274788f*i + -0.635691f*q)));
-        int blue = static_cast<int>(clamp(255.95f * (y + -1.108545f*i + 1.709007f*q)));
+    // The decoded line depends on where it falls on the carrier as well as the pixels
+    RowHash = (RowHash ^ phase) * RowHashPrime;
 
-        if (VideoOut != nullptr)
-        {
-            uint32_t pixel = (red << 16) | (green << 8) | blue | 0xFF000000;
-			FrameBuffer[FrameBufferIndex++] = pixel;
-        }
-        
+    if (VideoOut != nullptr)
+    {
+        // Decoded off-thread, the frame is fenced with WaitForLines before it is submitted
+        Ntsc.SubmitLine(NtscPixels.get() + (Line * 256), phase, FrameBuffer + FrameBufferIndex);
+        FrameBufferIndex += NtscDecoder::LINE_WIDTH;
     }
 }
 
@@ -1247,52 +1302,104 @@ void PPU::RenderPixel()
     DecodePixel(colour);
 }
 
-void PPU::RenderPixelIdle()
+void PPU::RenderPixelSkipped()
 {
-    if (TurboFrameSkip == 0)
+    // Nothing is drawn on a skipped frame, the only side effect of rendering a pixel
+    // the CPU can observe is a sprite 0 hit. The sprite shifters are reloaded for every
+    // line so rather than shifting them sprite 0's pixel is picked out by its X offset.
+    if (SpriteZeroSecondaryOamFlag && !SpriteZeroHitFlag && SpriteCounter[0] <= 0 && SpriteCounter[0] >= -7
+        && ShowSprites && (ShowSpritesLeft || Dot > 8)
+        && ShowBackground && (ShowBackgroundLeft || Dot > 8)
+        && Dot > 1 && Dot != 256)
     {
-        uint16_t colour;
+        int offset = -SpriteCounter[0];
+        int bit = (SpriteAttribute[0] & 0x40) ? offset : 7 - offset;
 
-        if (PpuAddress >= 0x3F00 && PpuAddress <= 0x3FFF)
-        {
-            colour = ReadPalette(PpuAddress);
-        }
-        else
-        {
-            colour = ReadPalette(0x3F00);
-        }
+        uint16_t spPixel = ((SpriteShift0[0] >> bit) & 0x1) | (((SpriteShift1[0] >> bit) & 0x1) << 1);
+        uint16_t bgPixel = (((BackgroundShift0 << FineXScroll) & 0x8000) >> 15) | (((BackgroundShift1 << FineXScroll) & 0x8000) >> 14);
+
+        SpriteZeroHitFlag = spPixel != 0 && bgPixel != 0;
+    }
 
-        DecodePixel(colour);
+    for (int i = 0; i < 8; ++i)
+    {
+        --SpriteCounter[i];
     }
 }
 
+void PPU::RenderPixelIdle()
+{
+    uint16_t colour;
+
+    if (PpuAddress >= 0x3F00 && PpuAddress <= 0x3FFF)
+    {
+        colour = ReadPalette(PpuAddress);
+    }
+    else
+    {
+        colour = ReadPalette(0x3F00);
+    }
+
+    DecodePixel(colour);
+}
+
 void PPU::DecodePixel(uint16_t colour)
 {
     if (TurboFrameSkip == 0)
     {
+        // Colour index with the emphasis bits above it, for the NTSC and GPU palette paths
+        uint16_t pixel = colour & 0x3F;
+        pixel = pixel | (IntenseRed << 6);
+        pixel = pixel | (IntenseGreen << 7);
+        pixel = pixel | (IntenseBlue << 8);
+
         // NTSC rendering is not supported in turbo mode
         if (!TurboModeEnabled && NtscMode)
         {
-            uint16_t pixel = colour & 0x3F;
-            pixel = pixel | (IntenseRed << 6);
-            pixel = pixel | (IntenseGreen << 7);
-            pixel = pixel | (IntenseBlue << 8);
+            RowHash = (RowHash ^ pixel) * RowHashPrime;
 
             RenderNtscPixel(pixel);
             if (Dot == 256) RenderNtscLine();
         }
+        else if (GpuPaletteMode)
+        {
+            // The backend's palette has a row for every combination of emphasis bits
+            RowHash = (RowHash ^ pixel) * RowHashPrime;
+
+            if (VideoOut != nullptr)
+            {
+                reinterpret_cast<uint16_t*>(FrameBuffer)[FrameBufferIndex++] = pixel;
+            }
+        }
         else
         {
+            RowHash = (RowHash ^ colour) * RowHashPrime;
+
             if (VideoOut != nullptr)
             {
                 FrameBuffer[FrameBufferIndex++] = RgbLookupTable[colour];
             }
         }
+
+        if (Dot == 256)
+        {
+            RowHashes[Line] = RowHash;
+            RowHash = RowHashBasis;
+        }
     }
 }
 
 void PPU::MaybeChangeModes()
 {
+    if (MaxSpeedModeEnabled != RequestMaxSpeedMode)
+    {
+        MaxSpeedModeEnabled = RequestMaxSpeedMode;
+        if (!MaxSpeedModeEnabled)
+        {
+            TurboFrameSkip = 0;
+        }
+    }
+
     if (TurboModeEnabled != RequestTurboMode)
     {
         TurboModeEnabled = RequestTurboMode;
@@ -1305,6 +1412,8 @@ void PPU::MaybeChangeModes()
     {
         NtscMode = RequestNtscMode;
     }
+
+    GpuPaletteMode = RequestGpuPaletteMode;
 }
 
 void PPU::IncrementXScroll()
@@ -1617,6 +1726,7 @@ void PPU::UpdateFrameRate()
         if (VideoOut != nullptr)
         {
             VideoOut->SetFps(CurrentFps);
+            VideoOut->SetSpeedMultiplier(MaxSpeedModeEnabled ? GetSpeedMultiplier() : 0.f);
         }
     }
     else
@@ -1627,11 +1737,27 @@ void PPU::UpdateFrameRate()
 
 void PPU::UpdateFrameSkipCounters()
 {
-    if (TurboModeEnabled)
+    if (MaxSpeedModeEnabled)
+    {
+        // Nothing is throttled in max speed mode, but there's no point drawing frames
+        // faster than the host can display them. Only draw the next frame if it's been
+        // at least one refresh interval since the last one was presented.
+        uint32_t presentRate = MaxSpeedPresentRate;
+        if (presentRate == 0)
+        {
+            TurboFrameSkip = 0;
+        }
+        else
+        {
+            std::chrono::microseconds interval(1000000 / presentRate);
+            TurboFrameSkip = std::chrono::steady_clock::now() - LastPresentTime >= interval ? 0 : 1;
+        }
+    }
+    else if (TurboModeEnabled)
     {
         if (TurboFrameSkip == 0)
         {
-            TurboFrameSkip = 20;
+            TurboFrameSkip = TurboFramesToSkip;
         }
         else
         {
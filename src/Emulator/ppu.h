@@ -10,10 +10,13 @@
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <memory>
 
 #include "cart.h"
 #include "state_save.h"
 #include "nes_callback.h"
+#include "frame_pacer.h"
+#include "video/ntsc_decoder.h"
 
 class CPU;
 class APU;
@@ -37,7 +40,13 @@ public:
     bool GetNMIActive();
 
     void SetTurboModeEnabled(bool enabled);
+    void SetTurboFrameSkip(int frames);
+    void SetMaxSpeedModeEnabled(bool enabled);
+    void SetMaxSpeedPresentRate(uint32_t rate);
+    void SetTargetFrameRate(uint32_t rate);
+    void SetAudioSyncEnabled(bool enabled);
     void SetNtscDecodingEnabled(bool enabled);
+    void SetGpuPaletteEnabled(bool enabled);
 
     uint8_t ReadPPUStatus();
     uint8_t ReadOAMData();
@@ -51,6 +60,7 @@ public:
     void WritePPUDATA(uint8_t M);
 
     int GetFrameRate();
+    float GetSpeedMultiplier();
     void GetNameTable(int table, uint8_t* pixels);
     void GetPatternTable(int table, int palette, uint8_t* pixels);
     void GetPalette(int palette, uint8_t* pixels);
@@ -78,6 +88,14 @@ private:
     std::atomic<bool> RequestTurboMode;
     bool TurboModeEnabled;
     int TurboFrameSkip;
+    std::atomic<int> TurboFramesToSkip;
+
+    std::atomic<bool> RequestMaxSpeedMode;
+    bool MaxSpeedModeEnabled;
+    std::atomic<uint32_t> MaxSpeedPresentRate;
+    std::chrono::steady_clock::time_point LastPresentTime;
+
+    FramePacer Pacer;
 
     uint64_t Clock;
     int32_t Dot;
@@ -158,13 +176,25 @@ private:
     int16_t SpriteCounter[8];
 
 	uint32_t FrameBufferIndex;
-	uint32_t FrameBuffer[256 * 240];
+	uint32_t* FrameBuffer; // Owned by VideoOut, fetched again at the start of every frame
+
+    // Hash of the values that went into each row of the frame, the video backend only
+    // uploads rows whose hash differs from what it already has
+    uint64_t RowHash;
+    uint64_t RowHashes[240];
 
     uint16_t PpuBusAddress;
 
     bool NtscMode;
     std::atomic<bool> RequestNtscMode;
-    float SignalLevels[256 * 8];
+
+    // Output palette indices and let the video backend look up the colours, or
+    // do the NTSC decoding when that's enabled
+    bool GpuPaletteMode;
+    std::atomic<bool> RequestGpuPaletteMode;
+    uint32_t NtscFramePhase;
+    std::unique_ptr<uint16_t[]> NtscPixels; // Kept out of line so it doesn't split up the rest of the PPU state
+    NtscDecoder Ntsc;
 
     void RenderNtscPixel(int pixel);
     void RenderNtscLine();
@@ -172,6 +202,7 @@ private:
     void SpriteEvaluation();
     void RenderPixel();
     void RenderPixelIdle();
+    void RenderPixelSkipped();
     void DecodePixel(uint16_t colour);
 
     void MaybeChangeModes();
@@ -0,0 +1,139 @@
+#if defined(__linux)
+
+#include <cstring>
+
+#include "egl_platform.h"
+#include "nes_exception.h"
+
+EGLPlatform::EGLPlatform(uint32_t width, uint32_t height)
+	: _width(width)
+	, _height(height)
+	, _display(EGL_NO_DISPLAY)
+	, _config(nullptr)
+	, _surface(EGL_NO_SURFACE)
+	, _context(EGL_NO_CONTEXT)
+{
+}
+
+EGLDisplay EGLPlatform::GetDisplay()
+{
+#if defined(EGL_PLATFORM_SURFACELESS_MESA)
+	// The default display wants an X server or a DRM device, the surfaceless platform works anywhere
+	const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (extensions != nullptr && strstr(extensions, "EGL_MESA_platform_surfaceless") != nullptr)
+	{
+		PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+			reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+		if (eglGetPlatformDisplayEXT != nullptr)
+		{
+			EGLDisplay display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+			if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+			{
+				return display;
+			}
+		}
+	}
+#endif
+
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+	{
+		return display;
+	}
+
+	return EGL_NO_DISPLAY;
+}
+
+void EGLPlatform::InitializeWindow(void*)
+{
+	_display = GetDisplay();
+
+	if (_display == EGL_NO_DISPLAY)
+	{
+		throw NesException("EGLPlatform", "Failed to initialize EGL display");
+	}
+
+	EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(_display, configAttributes, &_config, 1, &numConfigs) || numConfigs == 0)
+	{
+		eglTerminate(_display);
+		throw NesException("EGLPlatform", "Failed to choose EGL config");
+	}
+
+	EGLint surfaceAttributes[] = {
+		EGL_WIDTH, static_cast<EGLint>(_width),
+		EGL_HEIGHT, static_cast<EGLint>(_height),
+		EGL_NONE
+	};
+
+	_surface = eglCreatePbufferSurface(_display, _config, surfaceAttributes);
+	if (_surface == EGL_NO_SURFACE)
+	{
+		eglTerminate(_display);
+		throw NesException("EGLPlatform", "Failed to create EGL pbuffer surface");
+	}
+}
+
+void EGLPlatform::InitializeContext()
+{
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		throw NesException("EGLPlatform", "Failed to bind the OpenGL API");
+	}
+
+	_context = eglCreateContext(_display, _config, EGL_NO_CONTEXT, nullptr);
+	if (_context == EGL_NO_CONTEXT)
+	{
+		throw NesException("EGLPlatform", "Failed to create EGL context");
+	}
+
+	if (!eglMakeCurrent(_display, _surface, _surface, _context))
+	{
+		eglDestroyContext(_display, _context);
+		throw NesException("EGLPlatform", "Failed to make EGL context current");
+	}
+}
+
+void EGLPlatform::DestroyWindow()
+{
+	eglDestroySurface(_display, _surface);
+	eglTerminate(_display);
+	eglReleaseThread();
+}
+
+void EGLPlatform::DestroyContext()
+{
+	eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(_display, _context);
+}
+
+void EGLPlatform::SwapBuffers()
+{
+	// Pbuffers are single buffered, this just flushes
+	eglSwapBuffers(_display, _surface);
+}
+
+bool EGLPlatform::SetSwapInterval(int)
+{
+	// Nothing is ever displayed so there's no refresh to wait for
+	return false;
+}
+
+void EGLPlatform::UpdateSurfaceSize(uint32_t* width, uint32_t* height)
+{
+	*width = _width;
+	*height = _height;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#if defined(__linux)
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "igl_platform.h"
+
+// Offscreen GL platform with no window at all. The context renders into a pbuffer of a
+// fixed size, on Mesa's surfaceless display when it's available so no X server or GPU
+// is needed. Used to run the renderer on machines without a display, the output can be
+// read back with glReadPixels.
+class EGLPlatform : public IGLPlatform
+{
+public:
+	EGLPlatform(uint32_t width, uint32_t height);
+
+	virtual void InitializeWindow(void* windowHandle);
+	virtual void InitializeContext();
+	virtual void DestroyWindow();
+	virtual void DestroyContext();
+	virtual void SwapBuffers();
+	virtual bool SetSwapInterval(int interval);
+	virtual void UpdateSurfaceSize(uint32_t* width, uint32_t* height);
+
+private:
+	EGLDisplay GetDisplay();
+
+	uint32_t _width;
+	uint32_t _height;
+	EGLDisplay _display;
+	EGLConfig _config;
+	EGLSurface _surface;
+	EGLContext _context;
+};
+
+#endif
\ No newline at end of file
@@ -1,5 +1,12 @@
 #include "gl_util.h"
 
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux)
+#include <EGL/egl.h>
+#endif
+
 THREAD_LOCAL PFNGLGENVERTEXARRAYSPROC glGenVertexArrays = nullptr;
 THREAD_LOCAL PFNGLBINDVERTEXARRAYPROC glBindVertexArray = nullptr;
 THREAD_LOCAL PFNGLGENBUFFERSPROC glGenBuffers = nullptr;
@@ -23,13 +30,41 @@ THREAD_LOCAL PFNGLDELETESHADERPROC glDeleteShader = nullptr;
 THREAD_LOCAL PFNGLUSEPROGRAMPROC glUseProgram = nullptr;
 THREAD_LOCAL PFNGLUNIFORM1IPROC glUniform1i = nullptr;
 THREAD_LOCAL PFNGLUNIFORM2FPROC glUniform2f = nullptr;
+THREAD_LOCAL PFNGLUNIFORM1FPROC glUniform1f = nullptr;
 THREAD_LOCAL PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation = nullptr;
+THREAD_LOCAL PFNGLDELETEBUFFERSPROC glDeleteBuffers = nullptr;
+THREAD_LOCAL PFNGLMAPBUFFERRANGEPROC glMapBufferRange = nullptr;
+THREAD_LOCAL PFNGLUNMAPBUFFERPROC glUnmapBuffer = nullptr;
+THREAD_LOCAL PFNGLFENCESYNCPROC glFenceSync = nullptr;
+THREAD_LOCAL PFNGLCLIENTWAITSYNCPROC glClientWaitSync = nullptr;
+THREAD_LOCAL PFNGLDELETESYNCPROC glDeleteSync = nullptr;
+THREAD_LOCAL PFNGLBUFFERSTORAGEPROC glBufferStorage = nullptr;
+THREAD_LOCAL PFNGLGETPROGRAMBINARYPROC glGetProgramBinary = nullptr;
+THREAD_LOCAL PFNGLPROGRAMBINARYPROC glProgramBinary = nullptr;
+THREAD_LOCAL PFNGLPROGRAMPARAMETERIPROC glProgramParameteri = nullptr;
+THREAD_LOCAL PFNGLDELETEPROGRAMPROC glDeleteProgram = nullptr;
+
+#if defined(_WIN32)
+THREAD_LOCAL PFNGLACTIVETEXTUREPROC glActiveTexture = nullptr;
+#endif
 
 namespace
 {
 THREAD_LOCAL bool functionsInitialized = false;
 }
 
+#if defined(__linux)
+void (*LoadGLFunction(const char* name))()
+{
+	if (eglGetCurrentContext() != EGL_NO_CONTEXT)
+	{
+		return eglGetProcAddress(name);
+	}
+
+	return glXGetProcAddress(reinterpret_cast<const GLubyte*>(name));
+}
+#endif
+
 void InitializeGLFunctions()
 {
 	if (!functionsInitialized)
@@ -57,8 +92,66 @@ void InitializeGLFunctions()
 		glUseProgram = reinterpret_cast<PFNGLUSEPROGRAMPROC>(LOAD_OGL_FUNC("glUseProgram"));
 		glUniform1i = reinterpret_cast<PFNGLUNIFORM1IPROC>(LOAD_OGL_FUNC("glUniform1i"));
 		glUniform2f = reinterpret_cast<PFNGLUNIFORM2FPROC>(LOAD_OGL_FUNC("glUniform2f"));
+		glUniform1f = reinterpret_cast<PFNGLUNIFORM1FPROC>(LOAD_OGL_FUNC("glUniform1f"));
 		glGetUniformLocation = reinterpret_cast<PFNGLGETUNIFORMLOCATIONPROC>(LOAD_OGL_FUNC("glGetUniformLocation"));
+		glDeleteBuffers = reinterpret_cast<PFNGLDELETEBUFFERSPROC>(LOAD_OGL_FUNC("glDeleteBuffers"));
+		glMapBufferRange = reinterpret_cast<PFNGLMAPBUFFERRANGEPROC>(LOAD_OGL_FUNC("glMapBufferRange"));
+		glUnmapBuffer = reinterpret_cast<PFNGLUNMAPBUFFERPROC>(LOAD_OGL_FUNC("glUnmapBuffer"));
+		glFenceSync = reinterpret_cast<PFNGLFENCESYNCPROC>(LOAD_OGL_FUNC("glFenceSync"));
+		glClientWaitSync = reinterpret_cast<PFNGLCLIENTWAITSYNCPROC>(LOAD_OGL_FUNC("glClientWaitSync"));
+		glDeleteSync = reinterpret_cast<PFNGLDELETESYNCPROC>(LOAD_OGL_FUNC("glDeleteSync"));
+		glBufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(LOAD_OGL_FUNC("glBufferStorage"));
+		glGetProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYPROC>(LOAD_OGL_FUNC("glGetProgramBinary"));
+		glProgramBinary = reinterpret_cast<PFNGLPROGRAMBINARYPROC>(LOAD_OGL_FUNC("glProgramBinary"));
+		glProgramParameteri = reinterpret_cast<PFNGLPROGRAMPARAMETERIPROC>(LOAD_OGL_FUNC("glProgramParameteri"));
+		glDeleteProgram = reinterpret_cast<PFNGLDELETEPROGRAMPROC>(LOAD_OGL_FUNC("glDeleteProgram"));
+
+#if defined(_WIN32)
+		glActiveTexture = reinterpret_cast<PFNGLACTIVETEXTUREPROC>(LOAD_OGL_FUNC("glActiveTexture"));
+#endif
 
 		functionsInitialized = true;
 	}
-}
\ No newline at end of file
+}
+
+bool HasGLVersion(int major, int minor)
+{
+	const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+	int contextMajor = 0;
+	int contextMinor = 0;
+	if (version == nullptr || sscanf(version, "%d.%d", &contextMajor, &contextMinor) != 2)
+	{
+		return false;
+	}
+
+	return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+bool HasGLExtension(const char* extension)
+{
+	return HasExtension(reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS)), extension);
+}
+
+bool HasExtension(const char* extensions, const char* extension)
+{
+	if (extensions == nullptr)
+	{
+		return false;
+	}
+
+	size_t length = strlen(extension);
+	for (const char* match = strstr(extensions, extension); match != nullptr; match = strstr(match + length, extension))
+	{
+		// Make sure this isn't just a prefix of some other extension's name
+		bool startsWord = match == extensions || match[-1] == ' ';
+		bool endsWord = match[length] == ' ' || match[length] == '\0';
+
+		if (startsWord && endsWord)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -43,7 +43,10 @@
 #include <X11/Xlib.h>
 #include <GL/glx.h>
 #include <GL/gl.h>
-#define LOAD_OGL_FUNC(name) glXGetProcAddress(reinterpret_cast<const GLubyte*>(name))
+#define LOAD_OGL_FUNC(name) LoadGLFunction(name)
+
+// Looks the function up through EGL when an EGL context is current and GLX otherwise
+void (*LoadGLFunction(const char* name))();
 
 #endif
 
@@ -55,19 +58,44 @@
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
 typedef ptrdiff_t GLsizeiptr;
 typedef ptrdiff_t GLintptr;
 typedef char GLchar;
+typedef uint64_t GLuint64;
+typedef struct __GLsync *GLsync;
 
 #define GL_BGR             0x80E0
 #define GL_BGRA            0x80E1
 #define GL_STATIC_DRAW     0x88E4
+#define GL_DYNAMIC_DRAW    0x88E8
 #define GL_ARRAY_BUFFER    0x8892
 #define GL_FRAGMENT_SHADER 0x8B30
 #define GL_VERTEX_SHADER   0x8B31
 #define GL_COMPILE_STATUS  0x8B81
 #define GL_LINK_STATUS     0x8B82
 #define GL_INFO_LOG_LENGTH 0x8B84
+#define GL_STREAM_DRAW     0x88E0
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#define GL_MAP_WRITE_BIT   0x0002
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#define GL_MAP_UNSYNCHRONIZED_BIT 0x0020
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_WAIT_FAILED     0x911D
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+#if defined(_WIN32)
+// Windows only exports GL 1.1, everywhere else glActiveTexture comes from gl.h
+#define GL_TEXTURE0        0x84C0
+#define GL_TEXTURE1        0x84C1
+typedef void (APIENTRYP PFNGLACTIVETEXTUREPROC) (GLenum texture);
+extern THREAD_LOCAL PFNGLACTIVETEXTUREPROC glActiveTexture;
+#endif
 
 // Function Pointer Type Definitions
 typedef void (APIENTRYP PFNGLGENVERTEXARRAYSPROC) (GLsizei n, GLuint *arrays);
@@ -93,7 +121,19 @@ typedef void (APIENTRYP PFNGLDELETESHADERPROC) (GLuint shader);
 typedef void (APIENTRYP PFNGLUSEPROGRAMPROC) (GLuint program);
 typedef void (APIENTRYP PFNGLUNIFORM1IPROC) (GLint location, GLint v0);
 typedef void (APIENTRYP PFNGLUNIFORM2FPROC) (GLint location, GLfloat v0, GLfloat v1);
+typedef void (APIENTRYP PFNGLUNIFORM1FPROC) (GLint location, GLfloat v0);
 typedef GLint(APIENTRYP PFNGLGETUNIFORMLOCATIONPROC) (GLuint program, const GLchar *name);
+typedef void (APIENTRYP PFNGLDELETEBUFFERSPROC) (GLsizei n, const GLuint *buffers);
+typedef void *(APIENTRYP PFNGLMAPBUFFERRANGEPROC) (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (APIENTRYP PFNGLUNMAPBUFFERPROC) (GLenum target);
+typedef GLsync (APIENTRYP PFNGLFENCESYNCPROC) (GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRYP PFNGLCLIENTWAITSYNCPROC) (GLsync sync, GLbitfield flags, GLuint64 timeout);
+typedef void (APIENTRYP PFNGLDELETESYNCPROC) (GLsync sync);
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC) (GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC) (GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC) (GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC) (GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLDELETEPROGRAMPROC) (GLuint program);
 
 // Function Pointer Definitions
 extern THREAD_LOCAL PFNGLGENVERTEXARRAYSPROC glGenVertexArrays;
@@ -119,6 +159,26 @@ extern THREAD_LOCAL PFNGLDELETESHADERPROC glDeleteShader;
 extern THREAD_LOCAL PFNGLUSEPROGRAMPROC glUseProgram;
 extern THREAD_LOCAL PFNGLUNIFORM1IPROC glUniform1i;
 extern THREAD_LOCAL PFNGLUNIFORM2FPROC glUniform2f;
+extern THREAD_LOCAL PFNGLUNIFORM1FPROC glUniform1f;
 extern THREAD_LOCAL PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
+extern THREAD_LOCAL PFNGLDELETEBUFFERSPROC glDeleteBuffers;
+extern THREAD_LOCAL PFNGLMAPBUFFERRANGEPROC glMapBufferRange;
+extern THREAD_LOCAL PFNGLUNMAPBUFFERPROC glUnmapBuffer;
+extern THREAD_LOCAL PFNGLFENCESYNCPROC glFenceSync;
+extern THREAD_LOCAL PFNGLCLIENTWAITSYNCPROC glClientWaitSync;
+extern THREAD_LOCAL PFNGLDELETESYNCPROC glDeleteSync;
+extern THREAD_LOCAL PFNGLBUFFERSTORAGEPROC glBufferStorage;
+extern THREAD_LOCAL PFNGLGETPROGRAMBINARYPROC glGetProgramBinary;
+extern THREAD_LOCAL PFNGLPROGRAMBINARYPROC glProgramBinary;
+extern THREAD_LOCAL PFNGLPROGRAMPARAMETERIPROC glProgramParameteri;
+extern THREAD_LOCAL PFNGLDELETEPROGRAMPROC glDeleteProgram;
 
 extern void InitializeGLFunctions();
+
+// Check the version or extensions of the current context. Function pointers loaded by
+// InitializeGLFunctions may be non-null even when the context doesn't support them.
+extern bool HasGLVersion(int major, int minor);
+extern bool HasGLExtension(const char* extension);
+
+// Check a space separated extension string, such as the one from glXQueryExtensionsString
+extern bool HasExtension(const char* extensions, const char* extension);
@@ -75,6 +75,39 @@ void GLXPlatform::SwapBuffers()
     glXSwapBuffers(_display, _windowHandle);
 }
 
+bool GLXPlatform::SetSwapInterval(int interval)
+{
+    typedef void (*SwapIntervalEXT)(Display*, GLXDrawable, int);
+    typedef int (*SwapIntervalMESA)(unsigned int);
+    typedef int (*SwapIntervalSGI)(int);
+
+    // glXGetProcAddress returns something for any name, only the extension string says
+    // whether the function actually works
+    const char* extensions = glXQueryExtensionsString(_display, DefaultScreen(_display));
+
+    if (HasExtension(extensions, "GLX_EXT_swap_control"))
+    {
+        SwapIntervalEXT swapInterval = reinterpret_cast<SwapIntervalEXT>(LoadGLFunction("glXSwapIntervalEXT"));
+        swapInterval(_display, _windowHandle, interval);
+        return true;
+    }
+
+    if (HasExtension(extensions, "GLX_MESA_swap_control"))
+    {
+        SwapIntervalMESA swapInterval = reinterpret_cast<SwapIntervalMESA>(LoadGLFunction("glXSwapIntervalMESA"));
+        return swapInterval(static_cast<unsigned int>(interval)) == 0;
+    }
+
+    // The SGI version can't turn vsync off
+    if (interval > 0 && HasExtension(extensions, "GLX_SGI_swap_control"))
+    {
+        SwapIntervalSGI swapInterval = reinterpret_cast<SwapIntervalSGI>(LoadGLFunction("glXSwapIntervalSGI"));
+        return swapInterval(interval) == 0;
+    }
+
+    return false;
+}
+
 void GLXPlatform::UpdateSurfaceSize(uint32_t* width, uint32_t* height)
 {
     XWindowAttributes attributes;
@@ -13,6 +13,7 @@ public:
     virtual void DestroyWindow();
 	virtual void DestroyContext();
 	virtual void SwapBuffers();
+	virtual bool SetSwapInterval(int interval);
 	virtual void UpdateSurfaceSize(uint32_t* width, uint32_t* height);
 
 private:
@@ -4,6 +4,7 @@
 #include "wgl_platform.h"
 #elif defined(__linux)
 #include "glx_platform.h"
+#include "egl_platform.h"
 #endif
 
 
@@ -14,4 +15,13 @@ std::unique_ptr<IGLPlatform> IGLPlatform::CreateGLPlatform()
 #elif defined(__linux)
 	return std::unique_ptr<IGLPlatform>(new GLXPlatform());
 #endif
+}
+
+std::unique_ptr<IGLPlatform> IGLPlatform::CreateOffscreenGLPlatform(uint32_t width, uint32_t height)
+{
+#if defined(__linux)
+	return std::unique_ptr<IGLPlatform>(new EGLPlatform(width, height));
+#else
+	return nullptr;
+#endif
 }
\ No newline at end of file
@@ -8,11 +8,19 @@ class IGLPlatform
 public:
 	static std::unique_ptr<IGLPlatform> CreateGLPlatform();
 
+	// Platform that renders into an offscreen surface of the given size rather than a
+	// window. Returns nullptr where that isn't supported.
+	static std::unique_ptr<IGLPlatform> CreateOffscreenGLPlatform(uint32_t width, uint32_t height);
+
 	virtual void InitializeWindow(void* windowHandle) = 0;
 	virtual void InitializeContext() = 0;
 	virtual void DestroyWindow() = 0;
 	virtual void DestroyContext() = 0;
 	virtual void SwapBuffers() = 0;
+
+	// Number of vertical blanks SwapBuffers waits for, 0 to not wait. Returns false if
+	// the platform can't control it.
+	virtual bool SetSwapInterval(int interval) = 0;
 	virtual void UpdateSurfaceSize(uint32_t* width, uint32_t* height) = 0;
 
 	virtual ~IGLPlatform() = default;
@@ -0,0 +1,14 @@
+#include "isoftware_platform.h"
+
+#if defined(__linux)
+#include "x11_shm_platform.h"
+#endif
+
+std::unique_ptr<ISoftwarePlatform> ISoftwarePlatform::CreateSoftwarePlatform()
+{
+#if defined(__linux)
+	return std::unique_ptr<ISoftwarePlatform>(new X11ShmPlatform());
+#else
+	return nullptr;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+// Window system side of the software renderer. Frames are drawn by the CPU into a
+// 32-bit BGRA surface the size of the window, which the platform then puts on screen.
+class ISoftwarePlatform
+{
+public:
+	// Returns nullptr if there is no software presenter for this platform
+	static std::unique_ptr<ISoftwarePlatform> CreateSoftwarePlatform();
+
+	virtual void InitializeWindow(void* windowHandle) = 0;
+	virtual void DestroyWindow() = 0;
+	virtual void UpdateSurfaceSize(uint32_t* width, uint32_t* height) = 0;
+
+	// Surface for the next frame, pitch is in pixels. Only valid until the next call to
+	// UpdateSurfaceSize or Present. Returns nullptr if the window has no area.
+	virtual uint32_t* GetSurface(uint32_t* pitch) = 0;
+	virtual void Present() = 0;
+
+	virtual ~ISoftwarePlatform() = default;
+};
\ No newline at end of file
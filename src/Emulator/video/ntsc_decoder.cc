@@ -0,0 +1,333 @@
+#include "ntsc_decoder.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NTSC_DECODER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+constexpr float SignalLevels[16] =
+{
+	// Normal Levels
+	-0.116f / 12.f, 0.000f / 12.f, 0.307f / 12.f, 0.714f / 12.f,
+	 0.399f / 12.f, 0.684f / 12.f, 1.000f / 12.f, 1.000f / 12.f,
+	// Attenuated Levels
+	-0.087f / 12.f, 0.000f / 12.f, 0.229f / 12.f, 0.532f / 12.f,
+	 0.298f / 12.f, 0.510f / 12.f, 0.746f / 12.f, 0.746f / 12.f
+};
+
+constexpr float SineTable[12] =
+{
+	 0.89101f,  0.54464f,  0.05234f, -0.45399f, -0.83867f, -0.99863f,
+	-0.89101f, -0.54464f, -0.05234f,  0.45399f,  0.83867f,  0.99863f
+};
+
+// Each pixel is 8 samples wide, and a new pixel's carrier phase is 8 samples on
+constexpr uint32_t SAMPLES_PER_PIXEL = 8;
+constexpr uint32_t PHASE_STEP = 2;
+
+// Workers are woken after this many lines have been queued rather than every line
+constexpr uint32_t LINES_PER_WAKEUP = 16;
+constexpr uint32_t MAX_WORKERS = 4;
+
+bool InColorPhase(int color, int phase)
+{
+	return (color + phase) % 12 < 6;
+}
+
+float SignalLevel(uint32_t pixel, int phase)
+{
+	// Decode the NES color.
+	int color = (pixel & 0x0F);    // 0..15 "cccc"
+	int level = (pixel >> 4) & 3;  // 0..3  "ll"
+	int emphasis = (pixel >> 6);   // 0..7  "eee"
+	if (color > 13) { level = 1; } // For colors 14..15, level 1 is forced.
+
+	// The square wave for this color alternates between these two voltages:
+	int low = level;
+	int high = level + 4;
+
+	if (color == 0) { low = high; } // For color 0, only high level is emitted
+	if (color > 12) { high = low; } // For colors 13..15, only low level is emitted
+
+	int index = InColorPhase(color, phase) ? high : low;
+
+	// When de-emphasis bits are set, some parts of the signal are attenuated:
+	if (((emphasis & 1) && InColorPhase(0, phase)) || ((emphasis & 2) && InColorPhase(4, phase)) || ((emphasis & 4) && InColorPhase(8, phase)))
+	{
+		return SignalLevels[index + 8];
+	}
+	else
+	{
+		return SignalLevels[index];
+	}
+}
+}
+
+NtscDecoder::NtscDecoder()
+	: _kernels(new Kernel[NUM_PHASES * NUM_PIXEL_VALUES + 1])
+	, _submittedLines(0)
+	, _claimedLines(0)
+	, _completedLines(0)
+	, _workersStarted(false)
+	, _running(false)
+{
+	BuildKernels();
+}
+
+NtscDecoder::~NtscDecoder()
+{
+	StopWorkers();
+}
+
+void NtscDecoder::BuildKernels()
+{
+	for (uint32_t phaseIndex = 0; phaseIndex < NUM_PHASES; ++phaseIndex)
+	{
+		for (uint32_t pixel = 0; pixel < NUM_PIXEL_VALUES; ++pixel)
+		{
+			// Y, I and Q contributions to the previous, current and next output pixels
+			float yiq[3][3] = {};
+
+			for (uint32_t sample = 0; sample < SAMPLES_PER_PIXEL; ++sample)
+			{
+				int phase = (phaseIndex * 4 + sample) % 12;
+				float level = SignalLevel(pixel, phase);
+
+				float y = level;
+				float i = level * SineTable[(phase + 3) % 12];
+				float q = level * SineTable[phase];
+
+				// The 12 sample window of an output pixel reaches 2 samples into each neighbour
+				uint32_t firstTap = sample < 2 ? 0 : 1;
+				uint32_t lastTap = sample >= SAMPLES_PER_PIXEL - 2 ? 2 : 1;
+
+				for (uint32_t tap = firstTap; tap <= lastTap; ++tap)
+				{
+					yiq[tap][0] += y;
+					yiq[tap][1] += i;
+					yiq[tap][2] += q;
+				}
+			}
+
+			Kernel& kernel = _kernels[(phaseIndex * NUM_PIXEL_VALUES) + pixel];
+
+			for (uint32_t tap = 0; tap < 3; ++tap)
+			{
+				float y = yiq[tap][0];
+				float i = yiq[tap][1];
+				float q = yiq[tap][2];
+
+				// Stored in BGRA order to match the frame buffer layout. Alpha is only
+				// carried by the centre tap so the sum of the three taps is fully opaque.
+				kernel.Taps[tap][0] = 255.95f * (y + -1.108545f*i + 1.709007f*q);
+				kernel.Taps[tap][1] = 255.95f * (y + -0.274788f*i + -0.635691f*q);
+				kernel.Taps[tap][2] = 255.95f * (y + 0.946882f*i + 0.623557f*q);
+				kernel.Taps[tap][3] = tap == 1 ? 255.f : 0.f;
+			}
+		}
+	}
+
+	// Stand-in for the missing neighbours at either end of a line
+	Kernel& empty = _kernels[NUM_PHASES * NUM_PIXEL_VALUES];
+	for (uint32_t tap = 0; tap < 3; ++tap)
+	{
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			empty.Taps[tap][lane] = 0.f;
+		}
+	}
+}
+
+void NtscDecoder::DecodeLine(const uint16_t* pixels, uint32_t phase, uint32_t* output) const
+{
+	const Kernel* empty = &_kernels[NUM_PHASES * NUM_PIXEL_VALUES];
+
+	uint32_t phaseIndex = (phase / 4) % NUM_PHASES;
+
+	const Kernel* previous = empty;
+	const Kernel* current = &_kernels[(phaseIndex * NUM_PIXEL_VALUES) + (pixels[0] & 0x1FF)];
+
+#if defined(NTSC_DECODER_SSE2)
+	const __m128 minimum = _mm_setzero_ps();
+	const __m128 maximum = _mm_set1_ps(255.f);
+#endif
+
+	for (uint32_t x = 0; x < LINE_WIDTH; ++x)
+	{
+		phaseIndex = (phaseIndex + PHASE_STEP) % NUM_PHASES;
+
+		const Kernel* next = empty;
+		if (x + 1 < LINE_WIDTH)
+		{
+			next = &_kernels[(phaseIndex * NUM_PIXEL_VALUES) + (pixels[x + 1] & 0x1FF)];
+		}
+
+#if defined(NTSC_DECODER_SSE2)
+		// Plain new only guarantees 8 byte alignment on 32-bit targets, so the kernels
+		// can't be assumed to be 16 byte aligned
+		__m128 sum = _mm_add_ps(_mm_loadu_ps(previous->Taps[2]), _mm_loadu_ps(current->Taps[1]));
+		sum = _mm_add_ps(sum, _mm_loadu_ps(next->Taps[0]));
+		sum = _mm_min_ps(_mm_max_ps(sum, minimum), maximum);
+
+		__m128i bgra = _mm_cvttps_epi32(sum);
+		bgra = _mm_packs_epi32(bgra, bgra);
+		bgra = _mm_packus_epi16(bgra, bgra);
+
+		output[x] = static_cast<uint32_t>(_mm_cvtsi128_si32(bgra));
+#else
+		uint32_t pixel = 0;
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			float value = previous->Taps[2][lane] + current->Taps[1][lane] + next->Taps[0][lane];
+			value = (value > 255.0f) ? 255.0f : ((value < 0.0f) ? 0.0f : value);
+
+			pixel |= static_cast<uint32_t>(value) << (lane * 8);
+		}
+
+		output[x] = pixel;
+#endif
+
+		previous = current;
+		current = next;
+	}
+}
+
+void NtscDecoder::SubmitLine(const uint16_t* pixels, uint32_t phase, uint32_t* output)
+{
+	if (!_workersStarted)
+	{
+		StartWorkers();
+	}
+
+	if (_workers.empty())
+	{
+		DecodeLine(pixels, phase, output);
+		return;
+	}
+
+	uint64_t line = _submittedLines.load(std::memory_order_relaxed);
+
+	// Job slots are only reused once every line from the previous pass through them is done
+	if (line % MAX_PENDING_LINES == 0 && _completedLines.load(std::memory_order_acquire) != line)
+	{
+		WaitForLines();
+	}
+
+	LineJob& job = _jobs[line % MAX_PENDING_LINES];
+	job.Pixels = pixels;
+	job.Phase = phase;
+	job.Output = output;
+
+	_submittedLines.store(line + 1, std::memory_order_release);
+
+	if ((line + 1) % LINES_PER_WAKEUP == 0)
+	{
+		WakeWorkers();
+	}
+}
+
+void NtscDecoder::WaitForLines()
+{
+	uint64_t submitted = _submittedLines.load(std::memory_order_relaxed);
+
+	if (_completedLines.load(std::memory_order_acquire) == submitted)
+	{
+		return;
+	}
+
+	WakeWorkers();
+
+	// Rather than sleep, help out with whatever is left in the queue
+	while (DecodeNextLine()) {}
+
+	while (_completedLines.load(std::memory_order_acquire) != submitted)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void NtscDecoder::StartWorkers()
+{
+	_workersStarted = true;
+
+	uint32_t numThreads = std::thread::hardware_concurrency();
+	uint32_t numWorkers = numThreads > 1 ? std::min(numThreads - 1, MAX_WORKERS) : 0;
+
+	_running = true;
+
+	for (uint32_t i = 0; i < numWorkers; ++i)
+	{
+		_workers.emplace_back(&NtscDecoder::WorkerLoop, this);
+	}
+}
+
+void NtscDecoder::StopWorkers()
+{
+	{
+		std::unique_lock<std::mutex> lock(_workerMutex);
+		_running = false;
+	}
+
+	_workerCv.notify_all();
+
+	for (std::thread& worker : _workers)
+	{
+		worker.join();
+	}
+
+	_workers.clear();
+}
+
+void NtscDecoder::WakeWorkers()
+{
+	// Workers check for lines under the mutex. Taking it here means none of them can
+	// have checked before the lines were published and still be on its way to sleep,
+	// which would miss this wakeup and leave the whole batch to WaitForLines.
+	{
+		std::lock_guard<std::mutex> lock(_workerMutex);
+	}
+
+	_workerCv.notify_all();
+}
+
+void NtscDecoder::WorkerLoop()
+{
+	while (_running)
+	{
+		if (DecodeNextLine())
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_workerMutex);
+		_workerCv.wait(lock, [this]()
+		{
+			return !_running || _claimedLines.load(std::memory_order_relaxed) < _submittedLines.load(std::memory_order_relaxed);
+		});
+	}
+}
+
+bool NtscDecoder::DecodeNextLine()
+{
+	uint64_t line = _claimedLines.load(std::memory_order_relaxed);
+
+	do
+	{
+		if (line >= _submittedLines.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+	}
+	while (!_claimedLines.compare_exchange_weak(line, line + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+	const LineJob& job = _jobs[line % MAX_PENDING_LINES];
+	DecodeLine(job.Pixels, job.Phase, job.Output);
+
+	_completedLines.fetch_add(1, std::memory_order_release);
+
+	return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Composite NTSC decoder for PPU scanlines.
+ *
+ * Every PPU pixel produces 8 samples of composite signal and every output pixel
+ * is decoded from a 12 sample window centred on it, so each output pixel only
+ * depends on itself and its two neighbours. Since the decode is linear up until
+ * the final clamp, the contribution of a pixel to each of those three outputs
+ * can be computed ahead of time for every colour/emphasis value and carrier
+ * phase. Decoding a line is then three table lookups and adds per pixel.
+ *
+ * Lines can either be decoded synchronously with DecodeLine or queued with
+ * SubmitLine to be decoded by a pool of worker threads.
+ */
+class NtscDecoder
+{
+public:
+	NtscDecoder();
+	~NtscDecoder();
+
+	// Decode a line of pixels into 32-bit BGRA. Each input pixel is the 6-bit palette
+	// colour with the red, green and blue emphasis bits in bits 6-8. phase is the
+	// colour carrier phase (0, 4 or 8) of the first pixel on the line.
+	void DecodeLine(const uint16_t* pixels, uint32_t phase, uint32_t* output) const;
+
+	// Queue a line to be decoded on the worker threads. Both pixels and output
+	// must remain untouched until WaitForLines returns.
+	void SubmitLine(const uint16_t* pixels, uint32_t phase, uint32_t* output);
+
+	// Block until every submitted line has been decoded. The calling thread
+	// decodes any lines that have not been picked up by a worker yet.
+	void WaitForLines();
+
+	static constexpr uint32_t LINE_WIDTH = 256;
+	static constexpr uint32_t NUM_PIXEL_VALUES = 512;
+	static constexpr uint32_t NUM_PHASES = 3;
+	static constexpr uint32_t MAX_PENDING_LINES = 240;
+
+private:
+	// Contribution of a pixel to the previous, current and next output pixels
+	struct Kernel
+	{
+		alignas(16) float Taps[3][4];
+	};
+
+	struct LineJob
+	{
+		const uint16_t* Pixels;
+		uint32_t Phase;
+		uint32_t* Output;
+	};
+
+	void BuildKernels();
+	void StartWorkers();
+	void StopWorkers();
+	void WorkerLoop();
+	void WakeWorkers();
+	bool DecodeNextLine();
+
+	std::unique_ptr<Kernel[]> _kernels;
+
+	LineJob _jobs[MAX_PENDING_LINES];
+
+	// Monotonic line counters, a line's job slot is its number modulo MAX_PENDING_LINES
+	std::atomic<uint64_t> _submittedLines;
+	std::atomic<uint64_t> _claimedLines;
+	std::atomic<uint64_t> _completedLines;
+
+	bool _workersStarted;
+	std::atomic<bool> _running;
+	std::mutex _workerMutex;
+	std::condition_variable _workerCv;
+	std::vector<std::thread> _workers;
+};
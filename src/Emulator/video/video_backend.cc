@@ -1,7 +1,22 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VIDEO_BACKEND_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "video_backend.h"
 #include "osd_font.h"
 #include "igl_platform.h"
+#include "isoftware_platform.h"
+#include "ntsc_decoder.h"
 #include "nes_exception.h"
+#include "file.h"
 
 namespace
 {
@@ -9,6 +24,33 @@ static constexpr int32_t FRAME_WIDTH = 256;
 static constexpr int32_t FRAME_HEIGHT = 240;
 static constexpr int32_t NUM_OVERSCAN_LINES = 16;
 
+static constexpr uint32_t NUM_FRAME_BUFFERS = 3;
+static constexpr uint32_t FRAME_READY = 0x4;
+static constexpr uint32_t BUFFER_INDEX_MASK = 0x3;
+
+// Upper bound on how long a frame can sit unnoticed if the render thread misses a wakeup
+static constexpr std::chrono::milliseconds FRAME_WAIT_TIMEOUT(2);
+
+// Longest the emulator will wait for a present, in case the display stops refreshing
+// (a minimized window on some drivers) and SwapBuffers stops blocking or never returns
+static constexpr std::chrono::milliseconds VSYNC_WAIT_TIMEOUT(100);
+
+// Presents timed at startup to find the display's refresh rate, the first few are
+// thrown away since the driver may queue them without waiting
+static constexpr uint32_t REFRESH_WARMUP_SWAPS = 4;
+static constexpr uint32_t REFRESH_MEASUREMENT_SWAPS = 20;
+
+// Vsync only paces emulation when the refresh rate is this close to the emulated frame
+// rate. The audio can only be resampled by so much to make up the difference.
+static constexpr double VSYNC_RATE_TOLERANCE = 0.004;
+static constexpr double NATIVE_FRAME_RATE = 60.0988;
+
+// Longest ReadPresentedFrame waits for a frame, emulation may be paused
+static constexpr std::chrono::milliseconds CAPTURE_WAIT_TIMEOUT(1000);
+
+// How long to wait on an upload fence before giving up and writing to the buffer anyway
+static constexpr GLuint64 UPLOAD_FENCE_TIMEOUT = 100000000; // 100ms in nanoseconds
+
 const std::string frameVertexShader =
 R"(
 #version 110
@@ -52,6 +94,95 @@ void main() {
 }
 )";
 
+// Frame pixels are NES colour indices with the emphasis bits above them, packed little endian
+// into luminance/alpha. The actual colour comes from a 64x8 palette texture with a row for
+// each combination of emphasis bits.
+const std::string paletteFragmentShader =
+R"(
+#version 110
+varying vec2 uv;
+uniform sampler2D sampler;
+uniform sampler2D palette;
+void main() {
+	vec4 texel = texture2D(sampler, uv);
+	float pixel = floor(texel.r * 255.0 + 0.5) + 256.0 * floor(texel.a * 255.0 + 0.5);
+	float color = mod(pixel, 64.0);
+	float emphasis = floor(pixel / 64.0);
+	gl_FragColor = texture2D(palette, vec2((color + 0.5) / 64.0, (emphasis + 0.5) / 8.0));
+}
+)";
+
+// Composite NTSC decode of a frame of 9-bit colour + emphasis values, packed little endian
+// into luminance/alpha. Same algorithm as NtscDecoder, but the 12 sample window is centred on
+// the fragment rather than the pixel so larger windows get extra horizontal resolution.
+const std::string ntscFragmentShader =
+R"(
+#version 110
+varying vec2 uv;
+uniform sampler2D sampler;
+uniform vec2 frameSize;
+uniform float basePhase;
+uniform float lineOffset;
+
+bool inColorPhase(float color, float phase) {
+	return mod(color + phase, 12.0) < 6.0;
+}
+
+float signalLevel(float pixel, float phase) {
+	float color = mod(pixel, 16.0);
+	float level = mod(floor(pixel / 16.0), 4.0);
+	float emphasis = floor(pixel / 64.0);
+	if (color > 13.5) { level = 1.0; }
+
+	float low = level;
+	float high = level + 4.0;
+	if (color < 0.5) { low = high; }
+	if (color > 12.5) { high = low; }
+
+	float index = inColorPhase(color, phase) ? high : low;
+
+	bool attenuated = (mod(emphasis, 2.0) > 0.5 && inColorPhase(0.0, phase))
+		|| (mod(floor(emphasis / 2.0), 2.0) > 0.5 && inColorPhase(4.0, phase))
+		|| (emphasis > 3.5 && inColorPhase(8.0, phase));
+
+	vec4 lowLevels = attenuated ? vec4(-0.087, 0.0, 0.229, 0.532) : vec4(-0.116, 0.0, 0.307, 0.714);
+	vec4 highLevels = attenuated ? vec4(0.298, 0.510, 0.746, 0.746) : vec4(0.399, 0.684, 1.0, 1.0);
+	vec4 select = vec4(equal(vec4(mod(index, 4.0)), vec4(0.0, 1.0, 2.0, 3.0)));
+
+	return dot(index < 3.5 ? lowLevels : highLevels, select) / 12.0;
+}
+
+void main() {
+	float row = floor(fract(uv.y) * frameSize.y);
+	float v = (row + 0.5) / frameSize.y;
+	float linePhase = mod(basePhase + 4.0 * (row + lineOffset), 12.0);
+	float first = floor(uv.x * frameSize.x * 8.0) - 6.0;
+
+	vec3 yiq = vec3(0.0);
+	for (int i = 0; i < 12; ++i) {
+		float position = first + float(i);
+		float x = floor(position / 8.0);
+		if (x < 0.0 || x >= frameSize.x) {
+			continue;
+		}
+
+		vec4 texel = texture2D(sampler, vec2((x + 0.5) / frameSize.x, v));
+		float pixel = floor(texel.r * 255.0 + 0.5) + 256.0 * floor(texel.a * 255.0 + 0.5);
+		float phase = mod(linePhase + position, 12.0);
+		float level = signalLevel(pixel, phase);
+
+		yiq += level * vec3(1.0, sin(radians(63.0 - 30.0 * (phase + 3.0))), sin(radians(63.0 - 30.0 * phase)));
+	}
+
+	vec3 rgb = vec3(
+		yiq.x + 0.946882 * yiq.y + 0.623557 * yiq.z,
+		yiq.x - 0.274788 * yiq.y - 0.635691 * yiq.z,
+		yiq.x - 1.108545 * yiq.y + 1.709007 * yiq.z);
+
+	gl_FragColor = vec4(floor(clamp(rgb * 255.95, 0.0, 255.0)) / 255.0, 1.0);
+}
+)";
+
 const std::string textVertexShader =
 R"(
 #version 110
@@ -98,7 +229,7 @@ std::string toUpperCase(const std::string& str)
 	return allcaps;
 }
 
-void compileShaders(const std::string& vertexShader, const std::string& fragmentShader, GLuint* programId)
+void compileShaders(const std::string& vertexShader, const std::string& fragmentShader, GLuint* programId, bool retrievable)
 {
 	GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
 	GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
@@ -147,6 +278,12 @@ void compileShaders(const std::string& vertexShader, const std::string& fragment
 	GLint prgId = glCreateProgram();
 	glAttachShader(prgId, vertexShaderId);
 	glAttachShader(prgId, fragmentShaderId);
+
+	if (retrievable)
+	{
+		glProgramParameteri(prgId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
 	glLinkProgram(prgId);
 
 	glGetProgramiv(prgId, GL_LINK_STATUS, &result);
@@ -172,305 +309,1408 @@ void compileShaders(const std::string& vertexShader, const std::string& fragment
 
 	*programId = prgId;
 }
-}
 
-VideoBackend::VideoBackend(void* windowHandle)
+// Compiled programs are only valid for the exact driver that produced them, so the driver
+// strings go into the cache key along with the source
+std::string getProgramCacheKey(const std::string& vertexShader, const std::string& fragmentShader)
 {
-	_glPlatform = IGLPlatform::CreateGLPlatform();
-	_glPlatform->InitializeWindow(windowHandle);
+	std::string key;
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		const char* value = reinterpret_cast<const char*>(glGetString(name));
+		key += value != nullptr ? value : "";
+		key += '\n';
+	}
+
+	key += vertexShader;
+	key += '\0';
+	key += fragmentShader;
+
+	// FNV-1a
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for (char c : key)
+	{
+		hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001B3ULL;
+	}
+
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+
+	return name;
 }
 
-VideoBackend::~VideoBackend()
+bool loadCachedProgram(const std::string& path, GLuint* programId)
 {
-	_glPlatform->DestroyWindow();
+	std::ifstream stream(path.c_str(), std::ifstream::in | std::ifstream::binary);
+	if (!stream.good())
+	{
+		return false;
+	}
+
+	uint32_t format = 0;
+	stream.read(reinterpret_cast<char*>(&format), sizeof(format));
+
+	std::vector<char> binary((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	if (binary.empty())
+	{
+		return false;
+	}
+
+	GLuint prgId = glCreateProgram();
+	glProgramBinary(prgId, format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+	// Drivers are free to reject binaries, in which case it's compiled from source again
+	GLint result = GL_FALSE;
+	glGetProgramiv(prgId, GL_LINK_STATUS, &result);
+
+	if (result == GL_FALSE)
+	{
+		glDeleteProgram(prgId);
+		return false;
+	}
+
+	*programId = prgId;
+	return true;
 }
 
-void VideoBackend::Prepare()
+void storeCachedProgram(const std::string& path, GLuint programId)
 {
-	_glPlatform->InitializeContext();
+	GLint length = 0;
+	glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		return;
+	}
 
-	InitializeGLFunctions();
-	
-	try
+	std::vector<char> binary(length);
+	GLsizei written = 0;
+	GLenum format = 0;
+	glGetProgramBinary(programId, length, &written, &format, binary.data());
+	if (written <= 0)
 	{
-		compileShaders(frameVertexShader, frameFragmentShader, &_frameProgramId);
-		compileShaders(textVertexShader, textFragmentShader, &_textProgramId);
+		return;
 	}
-	catch (std::string& err)
+
+	// Written to the side and moved into place so an interrupted write is never picked up
+	std::string tempPath = path + ".tmp";
 	{
-		Finalize();
-		throw NesException("VideoBackend", err);
+		std::ofstream stream(tempPath.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+		uint32_t storedFormat = format;
+		stream.write(reinterpret_cast<const char*>(&storedFormat), sizeof(storedFormat));
+		stream.write(binary.data(), written);
+
+		if (!stream.good())
+		{
+			stream.close();
+			std::remove(tempPath.c_str());
+			return;
+		}
 	}
 
-	glGenVertexArrays(1, &_frameVertexArrayId);
-	glBindVertexArray(_frameVertexArrayId);
+	std::remove(path.c_str());
+	std::rename(tempPath.c_str(), path.c_str());
+}
 
-	static const GLfloat g_vertex_buffer_data[] = {
-		0.0f,  0.0f, 0.0f,
-		0.0f,  1.0f, 0.0f,
-		1.0f,  0.0f, 0.0f,
-		1.0f,  1.0f, 0.0f
-	};
+// Load a program from the binary cache if there's a usable one, otherwise compile it and add
+// it to the cache. An empty cache directory disables the cache.
+void loadProgram(const std::string& vertexShader, const std::string& fragmentShader, const std::string& cacheDirectory, GLuint* programId)
+{
+	if (cacheDirectory.empty())
+	{
+		compileShaders(vertexShader, fragmentShader, programId, false);
+		return;
+	}
 
-	// Generate 1 buffer, put the resulting identifier in vertexbuffer
-	glGenBuffers(1, &_frameVertexBuffer);
-	// The following commands will talk about our 'vertexbuffer' buffer
-	glBindBuffer(GL_ARRAY_BUFFER, _frameVertexBuffer);
-	// Give our vertices to OpenGL.
-	glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
+	std::string cachePath = file::createFullPath(getProgramCacheKey(vertexShader, fragmentShader), "bin", cacheDirectory);
+	if (loadCachedProgram(cachePath, programId))
+	{
+		return;
+	}
 
-	glGenTextures(1, &_frameTextureId);
-	glBindTexture(GL_TEXTURE_2D, _frameTextureId);
+	compileShaders(vertexShader, fragmentShader, programId, true);
+	storeCachedProgram(cachePath, *programId);
+}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+// Nearest neighbour scale of a row of pixels by a whole number
+void scaleRow(const uint32_t* source, uint32_t width, uint32_t scale, uint32_t* dest)
+{
+#if defined(VIDEO_BACKEND_SSE2)
+	if (scale == 2 && width % 4 == 0)
+	{
+		for (uint32_t x = 0; x < width; x += 4, dest += 8)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_unpacklo_epi32(pixels, pixels));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 4), _mm_unpackhi_epi32(pixels, pixels));
+		}
 
-	glGenTextures(1, &_textTextureId);
-	glBindTexture(GL_TEXTURE_2D, _textTextureId);
+		return;
+	}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	if (scale == 3 && width % 4 == 0)
+	{
+		for (uint32_t x = 0; x < width; x += 4, dest += 12)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(1, 0, 0, 0)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 4), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(2, 2, 1, 1)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 8), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(3, 3, 3, 2)));
+		}
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 512, 128, 0, GL_BGR, GL_UNSIGNED_BYTE, OSD_FONT_BITMAP);
+		return;
+	}
 
-	glGenBuffers(1, &_textVertexBuffer);
-	glGenBuffers(1, &_textUVBuffer);
+	if (scale >= 4)
+	{
+		for (uint32_t x = 0; x < width; ++x, dest += scale)
+		{
+			__m128i pixel = _mm_set1_epi32(static_cast<int>(source[x]));
+
+			uint32_t i = 0;
+			for (; i + 4 <= scale; i += 4)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), pixel);
+			}
+
+			for (; i < scale; ++i)
+			{
+				dest[i] = source[x];
+			}
+		}
+
+		return;
+	}
+#endif
+
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		for (uint32_t i = 0; i < scale; ++i)
+		{
+			*dest++ = source[x];
+		}
+	}
 }
 
-void VideoBackend::Finalize()
+// Nearest neighbour scale of a row of pixels down to a smaller width
+void shrinkRow(const uint32_t* source, uint32_t width, uint32_t destWidth, uint32_t* dest)
 {
-	_glPlatform->DestroyContext();
+	for (uint32_t x = 0; x < destWidth; ++x)
+	{
+		dest[x] = source[(x * width) / destWidth];
+	}
 }
 
-void VideoBackend::SubmitFrame(uint8_t * fb)
+void fillPixels(uint32_t* dest, uint32_t count, uint32_t colour)
 {
-	bool overscanEnabled = _overscanEnabled;
-	bool showingFps = _showingFps;
-	uint32_t currentFps = _currentFps;
-
-	UpdateSurfaceSize();
+	std::fill(dest, dest + count, colour);
+}
+}
 
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glViewport(0, 0, _windowWidth, _windowHeight);
+VideoBackend::VideoBackend(void* windowHandle)
+	: _windowHandle(windowHandle)
+	, _softwareRendering(false)
+	, _vsyncEnabled(false)
+	, _vsyncActive(false)
+	, _refreshRate(0.0)
+	, _targetFrameRate(60)
+	, _overscanEnabled(false)
+	, _showingFps(false)
+	, _windowWidth(0)
+	, _windowHeight(0)
+	, _currentFps(0)
+	, _speedMultiplier(0.f)
+	, _frameBuffers(new uint32_t[NUM_FRAME_BUFFERS * FRAME_WIDTH * FRAME_HEIGHT]())
+	, _backBuffer(0)
+	, _presentBuffer(1)
+	, _sharedBuffer(2)
+	, _rendering(false)
+	, _framesSubmitted(0)
+	, _framesPresented(0)
+	, _frameSamplerLocation(-1)
+	, _frameTextureHeight(0)
+	, _frameTextureFormat(FrameFormat::Bgra)
+	, _textureRowHashesValid(false)
+	, _textSamplerLocation(-1)
+	, _osdTextCount(0)
+	, _osdVertexCount(0)
+	, _pboUploadsSupported(false)
+	, _fencesSupported(false)
+	, _nextUploadBuffer(0)
+	, _persistentFrameBuffer(0)
+	, _persistentFrameMapping(nullptr)
+	, _offscreenWidth(0)
+	, _offscreenHeight(0)
+	, _captureRequested(false)
+	, _capturedWidth(0)
+	, _capturedHeight(0)
+{
+	for (uint32_t i = 0; i < NUM_FRAME_BUFFERS; ++i)
+	{
+		_frameBufferSlots[i] = _frameBuffers.get() + (i * FRAME_WIDTH * FRAME_HEIGHT);
+		_frameFormats[i] = FrameFormat::Bgra;
+		_frameNtscPhases[i] = 0;
+		_frameRowHashesValid[i] = false;
+		_frameSequences[i] = 0;
+		_frameFences[i] = nullptr;
+	}
 
-	glUseProgram(_frameProgramId);
+	memset(_palette, 0, sizeof(_palette));
+	_dirtyRows.reserve(FRAME_HEIGHT);
+}
 
-	glBindTexture(GL_TEXTURE_2D, _frameTextureId);
+VideoBackend::~VideoBackend()
+{
+	Finalize();
+}
 
-	GLint loc = glGetUniformLocation(_frameProgramId, "screenSize");
-	glUniform2f(loc, static_cast<float>(_windowWidth), static_cast<float>(_windowHeight));
+void VideoBackend::Prepare()
+{
+	std::promise<void> ready;
+	std::future<void> result = ready.get_future();
 
-	loc = glGetUniformLocation(_frameProgramId, "frameSize");
+	_rendering = true;
+	_renderThread = std::thread(&VideoBackend::RenderLoop, this, std::move(ready));
 
-	if (overscanEnabled)
+	try
 	{
-		fb = fb + (FRAME_WIDTH * (NUM_OVERSCAN_LINES / 2) * 4);
-
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, FRAME_WIDTH, FRAME_HEIGHT - NUM_OVERSCAN_LINES, 0, GL_BGRA, GL_UNSIGNED_BYTE, fb);
-		glUniform2f(loc, static_cast<float>(FRAME_WIDTH), static_cast<float>(FRAME_HEIGHT - NUM_OVERSCAN_LINES));
+		result.get();
 	}
-	else
+	catch (...)
 	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, FRAME_WIDTH, FRAME_HEIGHT, 0, GL_BGRA, GL_UNSIGNED_BYTE, fb);
-		glUniform2f(loc, static_cast<float>(FRAME_WIDTH), static_cast<float>(FRAME_HEIGHT));
+		_rendering = false;
+		_vsyncActive = false;
+		_renderThread.join();
+		throw;
+	}
+}
+
+void VideoBackend::Finalize()
+{
+	if (!_renderThread.joinable())
+	{
+		return;
 	}
 
-	glUniform1i(_frameTextureId, 0);
+	{
+		std::unique_lock<std::mutex> lock(_frameMutex);
+		_rendering = false;
+	}
 
-	// 1st attribute buffer : vertices
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, _frameVertexBuffer);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	_frameCv.notify_one();
+	_renderThread.join();
 
-	// Draw the triangle !
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glDisableVertexAttribArray(0);
+	_vsyncActive = false;
 
-	if (showingFps)
 	{
-		DrawFps(currentFps);
+		// Wake anyone waiting on a frame capture that will never come now
+		std::lock_guard<std::mutex> lock(_captureMutex);
 	}
 
-	DrawMessages();
-
-	SwapFrameBuffers();
+	_captureCv.notify_all();
 }
 
-void VideoBackend::SwapFrameBuffers()
+uint32_t* VideoBackend::GetFrameBuffer()
 {
-	_glPlatform->SwapBuffers();
+	return _frameBufferSlots[_backBuffer];
 }
 
-void VideoBackend::SetFps(uint32_t fps)
+void VideoBackend::SetSoftwareRenderingEnabled(bool enabled)
 {
-	_currentFps = fps;
+	_softwareRendering = enabled;
 }
 
-void VideoBackend::ShowFps(bool show)
+void VideoBackend::SetVsyncEnabled(bool enabled)
 {
-	_showingFps = show;
+	_vsyncEnabled = enabled;
 }
 
-void VideoBackend::ShowMessage(const std::string & message, uint32_t duration)
+bool VideoBackend::IsVsyncActive()
 {
-	using namespace std::chrono;
-
-	std::unique_lock<std::mutex> lock(_messageMutex);
+	if (!_vsyncActive)
+	{
+		return false;
+	}
 
-	steady_clock::time_point expires = steady_clock::now() + seconds(duration);
-	_messages.push_back(std::make_pair(toUpperCase(message), expires));
+	double frameRate = NATIVE_FRAME_RATE * (_targetFrameRate / 60.0);
+	return std::abs(_refreshRate / frameRate - 1.0) <= VSYNC_RATE_TOLERANCE;
 }
 
-void VideoBackend::SetOverscanEnabled(bool enabled)
+void VideoBackend::SetTargetFrameRate(uint32_t rate)
 {
-	_overscanEnabled = enabled;
+	_targetFrameRate = std::min(std::max(rate, 20U), 240U);
 }
 
-void VideoBackend::DrawFps(uint32_t fps)
+void VideoBackend::WaitForVsync()
 {
-	std::string fpsStr = std::to_string(fps);
-
-	uint32_t xPos = _windowWidth - 12 - static_cast<uint32_t>(fpsStr.length()) * OSD_FONT_BITMAP_CELL_WIDTH;
-	uint32_t yPos = _windowHeight - 12 - OSD_FONT_BITMAP_CELL_HEIGHT;
+	std::unique_lock<std::mutex> lock(_presentMutex);
+	_presentCv.wait_for(lock, VSYNC_WAIT_TIMEOUT, [this]()
+	{
+		return !_rendering || _framesPresented + 1 >= _framesSubmitted;
+	});
+}
 
-	DrawText(fpsStr, xPos, yPos);
+void VideoBackend::SetOffscreenSurfaceSize(uint32_t width, uint32_t height)
+{
+	_offscreenWidth = width;
+	_offscreenHeight = height;
 }
 
-void VideoBackend::DrawMessages()
+bool VideoBackend::ReadPresentedFrame(std::vector<uint32_t>& pixels, uint32_t* width, uint32_t* height)
 {
-	std::unique_lock<std::mutex> lock(_messageMutex);
+	if (_offscreenWidth == 0 || _offscreenHeight == 0)
+	{
+		return false;
+	}
 
-	if (_messages.empty())
+	std::unique_lock<std::mutex> lock(_captureMutex);
+
+	_captureRequested = true;
+	bool captured = _captureCv.wait_for(lock, CAPTURE_WAIT_TIMEOUT, [this]()
 	{
-		return;
+		return !_captureRequested || !_rendering;
+	});
+
+	if (!captured || _captureRequested)
+	{
+		_captureRequested = false;
+		return false;
 	}
 
-	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
-	std::vector<std::pair<std::string, std::chrono::steady_clock::time_point> > remaining;
-	for (auto& entry : _messages)
+	*width = _capturedWidth;
+	*height = _capturedHeight;
+	pixels.resize(_capturedWidth * _capturedHeight);
+
+	for (uint32_t y = 0; y < _capturedHeight; ++y)
 	{
-		if (entry.second > now)
+		const uint32_t* source = _capturedFrame.data() + ((_capturedHeight - 1 - y) * _capturedWidth);
+		uint32_t* dest = pixels.data() + (y * _capturedWidth);
+
+		for (uint32_t x = 0; x < _capturedWidth; ++x)
 		{
-			remaining.push_back(entry);
+			dest[x] = source[x] & 0x00FFFFFF;
 		}
 	}
 
-	_messages.swap(remaining);
+	return true;
+}
 
-	uint32_t xPos = 12;
-	uint32_t yPos = _windowHeight - 12 - OSD_FONT_BITMAP_CELL_HEIGHT;
+void VideoBackend::SetShaderCacheDirectory(const std::string& directory)
+{
+	_shaderCacheDirectory = directory;
+}
 
-	for (auto& entry : _messages)
+void VideoBackend::SetPalette(const uint32_t* palette)
+{
+	// Each emphasis bit darkens the two channels it doesn't name, by the same ratio
+	// the NTSC decoder attenuates the signal by
+	static constexpr double EMPHASIS_ATTENUATION = 0.746;
+
+	for (uint32_t emphasis = 0; emphasis < 8; ++emphasis)
 	{
-		const std::string& message = entry.first;
-		DrawText(message, xPos, yPos);
+		double red = (emphasis & 0x6) != 0 ? EMPHASIS_ATTENUATION : 1.0;
+		double green = (emphasis & 0x5) != 0 ? EMPHASIS_ATTENUATION : 1.0;
+		double blue = (emphasis & 0x3) != 0 ? EMPHASIS_ATTENUATION : 1.0;
 
-		yPos -= OSD_FONT_BITMAP_CELL_HEIGHT;
+		for (uint32_t color = 0; color < 64; ++color)
+		{
+			uint32_t rgb = palette[color];
+			uint32_t r = static_cast<uint32_t>(((rgb >> 16) & 0xFF) * red + 0.5);
+			uint32_t g = static_cast<uint32_t>(((rgb >> 8) & 0xFF) * green + 0.5);
+			uint32_t b = static_cast<uint32_t>((rgb & 0xFF) * blue + 0.5);
+
+			_palette[(emphasis * 64) + color] = (r << 16) | (g << 8) | b;
+		}
 	}
 }
 
-void VideoBackend::DrawText(const std::string & text, uint32_t xPos, uint32_t yPos)
+void VideoBackend::SubmitFrame(FrameFormat format, uint32_t ntscPhase, const uint64_t* rowHashes)
 {
-	static constexpr float uvWidth = static_cast<float>(OSD_FONT_BITMAP_CELL_WIDTH) / static_cast<float>(OSD_FONT_BITMAP_WIDTH);
-	static constexpr float uvHeight = static_cast<float>(OSD_FONT_BITMAP_CELL_HEIGHT) / static_cast<float>(OSD_FONT_BITMAP_HEIGHT);
+	// Published to the render thread along with the buffer by the exchange below
+	_frameFormats[_backBuffer] = format;
+	_frameNtscPhases[_backBuffer] = ntscPhase;
+	_frameRowHashesValid[_backBuffer] = rowHashes != nullptr;
+	_frameSequences[_backBuffer] = ++_framesSubmitted;
 
-	std::vector<float> vertices;
-	std::vector<float> uvs;
-
-	vertices.reserve(text.length() * 12);
-	uvs.reserve(text.length() * 12);
-
-	float x = static_cast<float>(xPos);
-	float y = static_cast<float>(yPos);
-
-	for (uint32_t i = 0; i < text.length(); ++i)
-	{
-		float upLeftX = x + i * OSD_FONT_BITMAP_CELL_WIDTH;
-		float upLeftY = y + OSD_FONT_BITMAP_CELL_HEIGHT;
-		float upRightX = x + i * OSD_FONT_BITMAP_CELL_WIDTH + OSD_FONT_BITMAP_CELL_WIDTH;
-		float upRightY = y + OSD_FONT_BITMAP_CELL_HEIGHT;
-
-		float downRightX = x + i * OSD_FONT_BITMAP_CELL_WIDTH + OSD_FONT_BITMAP_CELL_WIDTH;
-		float downRightY = y;
-		float downLeftX = x + i * OSD_FONT_BITMAP_CELL_WIDTH;
-		float downLeftY = y;
-
-		vertices.push_back(upLeftX);
-		vertices.push_back(upLeftY);
-		vertices.push_back(downLeftX);
-		vertices.push_back(downLeftY);
-		vertices.push_back(upRightX);
-		vertices.push_back(upRightY);
-		vertices.push_back(downRightX);
-		vertices.push_back(downRightY);
-		vertices.push_back(upRightX);
-		vertices.push_back(upRightY);
-		vertices.push_back(downLeftX);
-		vertices.push_back(downLeftY);
-
-		char character = text[i];
-		uint32_t index = character - 32;
-
-		uint32_t col = index % 36;
-		uint32_t row = index / 36;
-
-		float uvX = uvWidth * col;
-		float uvY = uvHeight * row;
-
-		float uvUpLeftX = uvX;
-		float uvUpLeftY = 1.f - uvY;
-		float uvUpRightX = uvX + uvWidth;
-		float uvUpRightY = 1.f - uvY;
-
-		float uvDownRightX = uvX + uvWidth;
-		float uvDownRightY = 1.f - (uvY + uvHeight);
-		float uvDownLeftX = uvX;
-		float uvDownLeftY = 1.f - (uvY + uvHeight);
-
-		uvs.push_back(uvUpLeftX);
-		uvs.push_back(uvUpLeftY);
-		uvs.push_back(uvDownLeftX);
-		uvs.push_back(uvDownLeftY);
-		uvs.push_back(uvUpRightX);
-		uvs.push_back(uvUpRightY);
-		uvs.push_back(uvDownRightX);
-		uvs.push_back(uvDownRightY);
-		uvs.push_back(uvUpRightX);
-		uvs.push_back(uvUpRightY);
-		uvs.push_back(uvDownLeftX);
-		uvs.push_back(uvDownLeftY);
+	if (rowHashes != nullptr)
+	{
+		memcpy(_frameRowHashes[_backBuffer], rowHashes, sizeof(_frameRowHashes[_backBuffer]));
 	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, _textVertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float)*vertices.size(), vertices.data(), GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, _textUVBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float)*uvs.size(), uvs.data(), GL_STATIC_DRAW);
-
-	glUseProgram(_textProgramId);
+	_backBuffer = _sharedBuffer.exchange(_backBuffer | FRAME_READY, std::memory_order_acq_rel) & BUFFER_INDEX_MASK;
 
-	// 1st attribute buffer : vertices
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, _textVertexBuffer);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	// Deliberately not taking the mutex here, a missed wakeup only costs FRAME_WAIT_TIMEOUT
+	_frameCv.notify_one();
+}
 
-	// 1st attribute buffer : UVs
+void VideoBackend::RenderLoop(std::promise<void> ready)
+{
+	try
+	{
+		// Software rendering blits to a window, there's none to blit to offscreen
+		if (_softwareRendering && _offscreenWidth == 0)
+		{
+			InitializeSoftwareRenderer();
+		}
+		else
+		{
+			InitializeRenderer();
+		}
+	}
+	catch (...)
+	{
+		ready.set_exception(std::current_exception());
+		return;
+	}
+
+	ready.set_value();
+
+	while (_rendering)
+	{
+		if ((_sharedBuffer.load(std::memory_order_acquire) & FRAME_READY) == 0)
+		{
+			std::unique_lock<std::mutex> lock(_frameMutex);
+			_frameCv.wait_for(lock, FRAME_WAIT_TIMEOUT, [this]()
+			{
+				return !_rendering || (_sharedBuffer.load(std::memory_order_acquire) & FRAME_READY) != 0;
+			});
+
+			continue;
+		}
+
+		// The buffer being handed back may be drawn into again right away
+		WaitForFrameUpload(_presentBuffer);
+
+		_presentBuffer = _sharedBuffer.exchange(_presentBuffer, std::memory_order_acq_rel) & BUFFER_INDEX_MASK;
+
+		if (_softwarePlatform != nullptr)
+		{
+			RenderFrameSoftware(_presentBuffer);
+			FramePresented(_presentBuffer);
+			continue;
+		}
+
+		RenderFrame(_presentBuffer);
+
+		if (_persistentFrameBuffer != 0)
+		{
+			_frameFences[_presentBuffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+
+		FramePresented(_presentBuffer);
+	}
+
+	if (_softwarePlatform != nullptr)
+	{
+		_softwarePlatform->DestroyWindow();
+		_softwarePlatform.reset();
+		return;
+	}
+
+	UnmapPersistentFrameBuffers();
+	_glPlatform->DestroyContext();
+	_glPlatform->DestroyWindow();
+	_glPlatform.reset();
+}
+
+void VideoBackend::InitializeRenderer()
+{
+	// The window is created here rather than up front so it's owned by the render thread
+	// and only exists for whichever renderer is in use
+	if (_offscreenWidth != 0 && _offscreenHeight != 0)
+	{
+		_glPlatform = IGLPlatform::CreateOffscreenGLPlatform(_offscreenWidth, _offscreenHeight);
+		if (_glPlatform == nullptr)
+		{
+			throw NesException("VideoBackend", "Offscreen rendering is not supported on this platform");
+		}
+	}
+	else
+	{
+		_glPlatform = IGLPlatform::CreateGLPlatform();
+	}
+
+	_glPlatform->InitializeWindow(_windowHandle);
+
+	try
+	{
+		_glPlatform->InitializeContext();
+	}
+	catch (NesException&)
+	{
+		_glPlatform->DestroyWindow();
+		_glPlatform.reset();
+		throw;
+	}
+
+	InitializeGLFunctions();
+
+	if (_vsyncEnabled)
+	{
+		_vsyncActive = _glPlatform->SetSwapInterval(1);
+
+		if (_vsyncActive)
+		{
+			MeasureRefreshRate();
+		}
+	}
+	
+	std::string cacheDirectory;
+
+	if (glGetProgramBinary != nullptr && glProgramBinary != nullptr && glProgramParameteri != nullptr
+		&& (HasGLVersion(4, 1) || HasGLExtension("GL_ARB_get_program_binary")))
+	{
+		GLint numFormats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+
+		if (numFormats > 0)
+		{
+			cacheDirectory = _shaderCacheDirectory;
+		}
+	}
+
+	try
+	{
+		loadProgram(frameVertexShader, frameFragmentShader, cacheDirectory, &_frameProgramId);
+		loadProgram(frameVertexShader, paletteFragmentShader, cacheDirectory, &_paletteProgramId);
+		loadProgram(frameVertexShader, ntscFragmentShader, cacheDirectory, &_ntscProgramId);
+		loadProgram(textVertexShader, textFragmentShader, cacheDirectory, &_textProgramId);
+	}
+	catch (std::string& err)
+	{
+		_glPlatform->DestroyContext();
+		_glPlatform->DestroyWindow();
+		_glPlatform.reset();
+		throw NesException("VideoBackend", err);
+	}
+
+	_frameSamplerLocation = glGetUniformLocation(_frameProgramId, "sampler");
+	_textSamplerLocation = glGetUniformLocation(_textProgramId, "sampler");
+
+	glGenVertexArrays(1, &_frameVertexArrayId);
+	glBindVertexArray(_frameVertexArrayId);
+
+	static const GLfloat g_vertex_buffer_data[] = {
+		0.0f,  0.0f, 0.0f,
+		0.0f,  1.0f, 0.0f,
+		1.0f,  0.0f, 0.0f,
+		1.0f,  1.0f, 0.0f
+	};
+
+	// Generate 1 buffer, put the resulting identifier in vertexbuffer
+	glGenBuffers(1, &_frameVertexBuffer);
+	// The following commands will talk about our 'vertexbuffer' buffer
+	glBindBuffer(GL_ARRAY_BUFFER, _frameVertexBuffer);
+	// Give our vertices to OpenGL.
+	glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
+
+	glGenTextures(1, &_frameTextureId);
+	glBindTexture(GL_TEXTURE_2D, _frameTextureId);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	_pboUploadsSupported = HasGLVersion(3, 0) || HasGLExtension("GL_ARB_map_buffer_range");
+	_fencesSupported = HasGLVersion(3, 2) || HasGLExtension("GL_ARB_sync");
+
+	if (_pboUploadsSupported)
+	{
+		glGenBuffers(NUM_UPLOAD_BUFFERS, _uploadBuffers);
+
+		for (uint32_t i = 0; i < NUM_UPLOAD_BUFFERS; ++i)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _uploadBuffers[i]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, FRAME_WIDTH * FRAME_HEIGHT * 4, nullptr, GL_STREAM_DRAW);
+			_uploadFences[i] = nullptr;
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	MapPersistentFrameBuffers();
+
+	// The palette lives on texture unit 1 for the lifetime of the context
+	glGenTextures(1, &_paletteTextureId);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, _paletteTextureId);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 64, 8, 0, GL_BGRA, GL_UNSIGNED_BYTE, _palette);
+	glActiveTexture(GL_TEXTURE0);
+
+	glGenTextures(1, &_textTextureId);
+	glBindTexture(GL_TEXTURE_2D, _textTextureId);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 512, 128, 0, GL_BGR, GL_UNSIGNED_BYTE, OSD_FONT_BITMAP);
+
+	glGenBuffers(1, &_textVertexBuffer);
+	_drawnOsdText.clear();
+	_osdVertexCount = 0;
+}
+
+void VideoBackend::RenderFrame(uint32_t buffer)
+{
+	uint8_t* fb = reinterpret_cast<uint8_t*>(_frameBufferSlots[buffer]);
+	FrameFormat format = _frameFormats[buffer];
+	uint32_t ntscPhase = _frameNtscPhases[buffer];
+	const uint64_t* rowHashes = _frameRowHashesValid[buffer] ? _frameRowHashes[buffer] : nullptr;
+
+	bool overscanEnabled = _overscanEnabled;
+	bool showingFps = _showingFps;
+	uint32_t currentFps = _currentFps;
+	float speedMultiplier = _speedMultiplier;
+
+	UpdateSurfaceSize();
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glViewport(0, 0, _windowWidth, _windowHeight);
+
+	GLuint programId = _frameProgramId;
+
+	if (format == FrameFormat::PaletteIndex)
+	{
+		programId = _paletteProgramId;
+	}
+	else if (format == FrameFormat::NtscIndex)
+	{
+		programId = _ntscProgramId;
+	}
+
+	glUseProgram(programId);
+
+	glBindTexture(GL_TEXTURE_2D, _frameTextureId);
+
+	GLint loc = glGetUniformLocation(programId, "screenSize");
+	glUniform2f(loc, static_cast<float>(_windowWidth), static_cast<float>(_windowHeight));
+
+	loc = glGetUniformLocation(programId, "frameSize");
+
+	if (overscanEnabled)
+	{
+		UploadFrame(fb, NUM_OVERSCAN_LINES / 2, FRAME_HEIGHT - NUM_OVERSCAN_LINES, format, rowHashes);
+		glUniform2f(loc, static_cast<float>(FRAME_WIDTH), static_cast<float>(FRAME_HEIGHT - NUM_OVERSCAN_LINES));
+	}
+	else
+	{
+		UploadFrame(fb, 0, FRAME_HEIGHT, format, rowHashes);
+		glUniform2f(loc, static_cast<float>(FRAME_WIDTH), static_cast<float>(FRAME_HEIGHT));
+	}
+
+	if (format == FrameFormat::PaletteIndex)
+	{
+		glUniform1i(glGetUniformLocation(programId, "sampler"), 0);
+		glUniform1i(glGetUniformLocation(programId, "palette"), 1);
+	}
+	else if (format == FrameFormat::NtscIndex)
+	{
+		glUniform1i(glGetUniformLocation(programId, "sampler"), 0);
+		glUniform1f(glGetUniformLocation(programId, "basePhase"), static_cast<float>(ntscPhase));
+		glUniform1f(glGetUniformLocation(programId, "lineOffset"), overscanEnabled ? static_cast<float>(NUM_OVERSCAN_LINES / 2) : 0.f);
+	}
+	else
+	{
+		glUniform1i(_frameSamplerLocation, 0);
+	}
+
+	// 1st attribute buffer : vertices
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, _frameVertexBuffer);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+	// Draw the triangle !
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glDisableVertexAttribArray(0);
+
+	if (showingFps)
+	{
+		DrawFps(currentFps, speedMultiplier);
+	}
+
+	DrawMessages();
+	DrawOsd();
+
+	SwapFrameBuffers();
+}
+
+void VideoBackend::UploadFrame(uint8_t* fb, uint32_t firstRow, uint32_t height, FrameFormat format, const uint64_t* rowHashes)
+{
+	GLenum pixelFormat = GL_BGRA;
+	GLint internalFormat = GL_RGBA;
+	uint32_t bytesPerPixel = 4;
+
+	if (format == FrameFormat::PaletteIndex || format == FrameFormat::NtscIndex)
+	{
+		// Low byte of each pixel ends up in luminance and the high byte in alpha
+		pixelFormat = GL_LUMINANCE_ALPHA;
+		internalFormat = GL_LUMINANCE8_ALPHA8;
+		bytesPerPixel = 2;
+	}
+
+	// Texture storage only needs to be allocated again when overscan or the frame format changes
+	if (_frameTextureHeight != height || _frameTextureFormat != format)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, FRAME_WIDTH, height, 0, pixelFormat, GL_UNSIGNED_BYTE, nullptr);
+		_frameTextureHeight = height;
+		_frameTextureFormat = format;
+		_textureRowHashesValid = false;
+	}
+
+	// Collect the runs of rows that changed since the last upload
+	bool compareRows = _textureRowHashesValid && rowHashes != nullptr;
+
+	_dirtyRows.clear();
+	for (uint32_t row = 0; row < height;)
+	{
+		if (compareRows && _textureRowHashes[firstRow + row] == rowHashes[firstRow + row])
+		{
+			++row;
+			continue;
+		}
+
+		uint32_t spanStart = row;
+		while (row < height && !(compareRows && _textureRowHashes[firstRow + row] == rowHashes[firstRow + row]))
+		{
+			++row;
+		}
+
+		_dirtyRows.push_back(std::make_pair(spanStart, row - spanStart));
+	}
+
+	if (rowHashes != nullptr)
+	{
+		memcpy(_textureRowHashes, rowHashes, sizeof(_textureRowHashes));
+	}
+
+	_textureRowHashesValid = rowHashes != nullptr;
+
+	// Nothing changed, the texture already holds this frame
+	if (_dirtyRows.empty())
+	{
+		return;
+	}
+
+	size_t stride = FRAME_WIDTH * bytesPerPixel;
+	fb += firstRow * stride;
+
+	if (_persistentFrameBuffer != 0)
+	{
+		// The frame is already in the buffer, the texture is sourced from its offset within it
+		GLintptr offset = fb - _persistentFrameMapping;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _persistentFrameBuffer);
+		for (const auto& span : _dirtyRows)
+		{
+			GLintptr spanOffset = offset + (span.first * stride);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, span.first, FRAME_WIDTH, span.second, pixelFormat, GL_UNSIGNED_BYTE, reinterpret_cast<void*>(spanOffset));
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return;
+	}
+
+	if (!_pboUploadsSupported)
+	{
+		for (const auto& span : _dirtyRows)
+		{
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, span.first, FRAME_WIDTH, span.second, pixelFormat, GL_UNSIGNED_BYTE, fb + (span.first * stride));
+		}
+		return;
+	}
+
+	uint32_t index = _nextUploadBuffer;
+	_nextUploadBuffer = (_nextUploadBuffer + 1) % NUM_UPLOAD_BUFFERS;
+
+	GLbitfield access = GL_MAP_WRITE_BIT;
+
+	if (_fencesSupported)
+	{
+		if (_uploadFences[index] != nullptr)
+		{
+			glClientWaitSync(_uploadFences[index], GL_SYNC_FLUSH_COMMANDS_BIT, UPLOAD_FENCE_TIMEOUT);
+			glDeleteSync(_uploadFences[index]);
+			_uploadFences[index] = nullptr;
+		}
+
+		// The fence guarantees the GPU is done with this buffer so there's no need for the
+		// driver to synchronize the mapping
+		access |= GL_MAP_UNSYNCHRONIZED_BIT;
+	}
+	else
+	{
+		// Without fences let the driver hand back fresh storage instead of stalling. Only the
+		// dirty rows are written and read back so the rest of it being undefined is fine.
+		access |= GL_MAP_INVALIDATE_BUFFER_BIT;
+	}
+
+	size_t size = stride * height;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _uploadBuffers[index]);
+
+	uint8_t* mapped = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, access));
+	if (mapped != nullptr)
+	{
+		for (const auto& span : _dirtyRows)
+		{
+			memcpy(mapped + (span.first * stride), fb + (span.first * stride), span.second * stride);
+		}
+
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// With a pixel unpack buffer bound the data argument is an offset into the buffer
+		for (const auto& span : _dirtyRows)
+		{
+			GLintptr spanOffset = span.first * stride;
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, span.first, FRAME_WIDTH, span.second, pixelFormat, GL_UNSIGNED_BYTE, reinterpret_cast<void*>(spanOffset));
+		}
+
+		if (_fencesSupported)
+		{
+			_uploadFences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	else
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		for (const auto& span : _dirtyRows)
+		{
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, span.first, FRAME_WIDTH, span.second, pixelFormat, GL_UNSIGNED_BYTE, fb + (span.first * stride));
+		}
+	}
+}
+
+void VideoBackend::SwapFrameBuffers()
+{
+	if (_offscreenWidth != 0 && _offscreenHeight != 0)
+	{
+		CapturePresentedFrame();
+	}
+
+	_glPlatform->SwapBuffers();
+}
+
+void VideoBackend::MeasureRefreshRate()
+{
+	typedef std::chrono::steady_clock Clock;
+
+	std::vector<double> intervals;
+	intervals.reserve(REFRESH_MEASUREMENT_SWAPS);
+
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+	Clock::time_point last = Clock::now();
+	for (uint32_t i = 0; i < REFRESH_WARMUP_SWAPS + REFRESH_MEASUREMENT_SWAPS; ++i)
+	{
+		glClear(GL_COLOR_BUFFER_BIT);
+		_glPlatform->SwapBuffers();
+
+		// Some drivers return from the swap straight away and only block on the next
+		// command, this makes sure the present has really happened
+		glFinish();
+
+		Clock::time_point now = Clock::now();
+		if (i >= REFRESH_WARMUP_SWAPS)
+		{
+			intervals.push_back(std::chrono::duration<double>(now - last).count());
+		}
+
+		last = now;
+	}
+
+	// The median shrugs off the odd present that got held up by something else
+	std::nth_element(intervals.begin(), intervals.begin() + intervals.size() / 2, intervals.end());
+	double interval = intervals[intervals.size() / 2];
+
+	_refreshRate = interval > 0.0 ? 1.0 / interval : 0.0;
+}
+
+void VideoBackend::FramePresented(uint32_t buffer)
+{
+	if (!_vsyncActive)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_presentMutex);
+		_framesPresented = _frameSequences[buffer];
+	}
+
+	_presentCv.notify_one();
+}
+
+void VideoBackend::CapturePresentedFrame()
+{
+	{
+		std::lock_guard<std::mutex> lock(_captureMutex);
+
+		// Reading back stalls until the GPU has finished the frame, so only do it when asked
+		if (!_captureRequested)
+		{
+			return;
+		}
+
+		_capturedFrame.resize(_windowWidth * _windowHeight);
+		_capturedWidth = _windowWidth;
+		_capturedHeight = _windowHeight;
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, _windowWidth, _windowHeight, GL_BGRA, GL_UNSIGNED_BYTE, _capturedFrame.data());
+
+		_captureRequested = false;
+	}
+
+	_captureCv.notify_all();
+}
+
+void VideoBackend::MapPersistentFrameBuffers()
+{
+	bool supported = _fencesSupported && glBufferStorage != nullptr
+		&& (HasGLVersion(4, 4) || HasGLExtension("GL_ARB_buffer_storage"));
+
+	if (!supported)
+	{
+		return;
+	}
+
+	GLsizeiptr size = NUM_FRAME_BUFFERS * FRAME_WIDTH * FRAME_HEIGHT * sizeof(uint32_t);
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &_persistentFrameBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _persistentFrameBuffer);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (mapped == nullptr)
+	{
+		// Fall back to the heap buffers and copying through the upload ring
+		glDeleteBuffers(1, &_persistentFrameBuffer);
+		_persistentFrameBuffer = 0;
+		return;
+	}
+
+	_persistentFrameMapping = static_cast<uint8_t*>(mapped);
+
+	// Nothing is drawing into the frame buffers until Prepare returns, so they can be
+	// moved over without any synchronization beyond the ready promise
+	for (uint32_t i = 0; i < NUM_FRAME_BUFFERS; ++i)
+	{
+		_frameBufferSlots[i] = reinterpret_cast<uint32_t*>(_persistentFrameMapping) + (i * FRAME_WIDTH * FRAME_HEIGHT);
+	}
+}
+
+void VideoBackend::UnmapPersistentFrameBuffers()
+{
+	if (_persistentFrameBuffer == 0)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < NUM_FRAME_BUFFERS; ++i)
+	{
+		WaitForFrameUpload(i);
+		_frameBufferSlots[i] = _frameBuffers.get() + (i * FRAME_WIDTH * FRAME_HEIGHT);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _persistentFrameBuffer);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &_persistentFrameBuffer);
+
+	_persistentFrameBuffer = 0;
+	_persistentFrameMapping = nullptr;
+}
+
+void VideoBackend::WaitForFrameUpload(uint32_t buffer)
+{
+	if (_frameFences[buffer] != nullptr)
+	{
+		glClientWaitSync(_frameFences[buffer], GL_SYNC_FLUSH_COMMANDS_BIT, UPLOAD_FENCE_TIMEOUT);
+		glDeleteSync(_frameFences[buffer]);
+		_frameFences[buffer] = nullptr;
+	}
+}
+
+void VideoBackend::SetFps(uint32_t fps)
+{
+	_currentFps = fps;
+}
+
+void VideoBackend::SetSpeedMultiplier(float multiplier)
+{
+	_speedMultiplier = multiplier;
+}
+
+void VideoBackend::ShowFps(bool show)
+{
+	_showingFps = show;
+}
+
+void VideoBackend::ShowMessage(const std::string & message, uint32_t duration)
+{
+	using namespace std::chrono;
+
+	std::unique_lock<std::mutex> lock(_messageMutex);
+
+	steady_clock::time_point expires = steady_clock::now() + seconds(duration);
+	_messages.push_back(std::make_pair(toUpperCase(message), expires));
+}
+
+void VideoBackend::SetOverscanEnabled(bool enabled)
+{
+	_overscanEnabled = enabled;
+}
+
+void VideoBackend::DrawFps(uint32_t fps, float speedMultiplier)
+{
+	std::string fpsStr = std::to_string(fps);
+
+	// A multiplier of 0 means the emulator is running at its normal rate
+	if (speedMultiplier > 0.f)
+	{
+		uint32_t tenths = static_cast<uint32_t>(speedMultiplier * 10.f + 0.5f);
+		fpsStr += " " + std::to_string(tenths / 10) + "." + std::to_string(tenths % 10) + "X";
+	}
+
+	uint32_t xPos = _windowWidth - 12 - static_cast<uint32_t>(fpsStr.length()) * OSD_FONT_BITMAP_CELL_WIDTH;
+	uint32_t yPos = _windowHeight - 12 - OSD_FONT_BITMAP_CELL_HEIGHT;
+
+	DrawText(fpsStr, xPos, yPos);
+}
+
+void VideoBackend::DrawMessages()
+{
+	std::unique_lock<std::mutex> lock(_messageMutex);
+
+	if (_messages.empty())
+	{
+		return;
+	}
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	_messages.erase(std::remove_if(_messages.begin(), _messages.end(), [now](const std::pair<std::string, std::chrono::steady_clock::time_point>& entry)
+	{
+		return entry.second <= now;
+	}), _messages.end());
+
+	uint32_t xPos = 12;
+	uint32_t yPos = _windowHeight - 12 - OSD_FONT_BITMAP_CELL_HEIGHT;
+
+	for (auto& entry : _messages)
+	{
+		const std::string& message = entry.first;
+		DrawText(message, xPos, yPos);
+
+		yPos -= OSD_FONT_BITMAP_CELL_HEIGHT;
+	}
+}
+
+void VideoBackend::DrawText(const std::string & text, uint32_t xPos, uint32_t yPos)
+{
+	// Entries are assigned over rather than recreated so their strings keep their storage
+	if (_osdTextCount == _osdText.size())
+	{
+		_osdText.emplace_back();
+	}
+
+	OsdText& entry = _osdText[_osdTextCount++];
+	entry.text = text;
+	entry.xPos = xPos;
+	entry.yPos = yPos;
+}
+
+void VideoBackend::DrawOsd()
+{
+	static constexpr float uvWidth = static_cast<float>(OSD_FONT_BITMAP_CELL_WIDTH) / static_cast<float>(OSD_FONT_BITMAP_WIDTH);
+	static constexpr float uvHeight = static_cast<float>(OSD_FONT_BITMAP_CELL_HEIGHT) / static_cast<float>(OSD_FONT_BITMAP_HEIGHT);
+
+	size_t textCount = _osdTextCount;
+	_osdTextCount = 0;
+
+	bool changed = textCount != _drawnOsdText.size()
+		|| !std::equal(_drawnOsdText.begin(), _drawnOsdText.end(), _osdText.begin());
+
+	if (changed)
+	{
+		_drawnOsdText.assign(_osdText.begin(), _osdText.begin() + textCount);
+		_osdGeometry.clear();
+
+		for (const OsdText& entry : _drawnOsdText)
+		{
+			const std::string& text = entry.text;
+			float x = static_cast<float>(entry.xPos);
+			float y = static_cast<float>(entry.yPos);
+
+			for (uint32_t i = 0; i < text.length(); ++i)
+			{
+				float left = x + i * OSD_FONT_BITMAP_CELL_WIDTH;
+				float right = left + OSD_FONT_BITMAP_CELL_WIDTH;
+				float top = y + OSD_FONT_BITMAP_CELL_HEIGHT;
+				float bottom = y;
+
+				char character = text[i];
+				uint32_t index = character - 32;
+
+				uint32_t col = index % 36;
+				uint32_t row = index / 36;
+
+				float uvLeft = uvWidth * col;
+				float uvRight = uvLeft + uvWidth;
+				float uvTop = 1.f - (uvHeight * row);
+				float uvBottom = uvTop - uvHeight;
+
+				// Two triangles per glyph, position and UV interleaved
+				const float glyph[] = {
+					left,  top,    uvLeft,  uvTop,
+					left,  bottom, uvLeft,  uvBottom,
+					right, top,    uvRight, uvTop,
+					right, bottom, uvRight, uvBottom,
+					right, top,    uvRight, uvTop,
+					left,  bottom, uvLeft,  uvBottom
+				};
+
+				_osdGeometry.insert(_osdGeometry.end(), std::begin(glyph), std::end(glyph));
+			}
+		}
+
+		_osdVertexCount = static_cast<GLsizei>(_osdGeometry.size() / 4);
+
+		if (_osdVertexCount > 0)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, _textVertexBuffer);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(float) * _osdGeometry.size(), _osdGeometry.data(), GL_DYNAMIC_DRAW);
+		}
+	}
+
+	if (_osdVertexCount == 0)
+	{
+		return;
+	}
+
+	glUseProgram(_textProgramId);
+
+	glBindBuffer(GL_ARRAY_BUFFER, _textVertexBuffer);
+
+	// 1st attribute buffer : vertices
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+
+	// 2nd attribute buffer : UVs
 	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, _textUVBuffer);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
 	GLint loc = glGetUniformLocation(_textProgramId, "screenSize");
 	glUniform2f(loc, static_cast<float>(_windowWidth), static_cast<float>(_windowHeight));
 
 	glBindTexture(GL_TEXTURE_2D, _textTextureId);
-	glUniform1i(_textTextureId, 0);
+	glUniform1i(_textSamplerLocation, 0);
 
-	glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size() / 2));
+	glDrawArrays(GL_TRIANGLES, 0, _osdVertexCount);
 
 	glDisableVertexAttribArray(0);
 	glDisableVertexAttribArray(1);
 }
 
+void VideoBackend::InitializeSoftwareRenderer()
+{
+	_softwarePlatform = ISoftwarePlatform::CreateSoftwarePlatform();
+	if (_softwarePlatform == nullptr)
+	{
+		throw NesException("VideoBackend", "Software rendering is not supported on this platform");
+	}
+
+	try
+	{
+		_softwarePlatform->InitializeWindow(_windowHandle);
+	}
+	catch (NesException&)
+	{
+		_softwarePlatform.reset();
+		throw;
+	}
+
+	if (_softwareNtsc == nullptr)
+	{
+		_softwareNtsc.reset(new NtscDecoder());
+	}
+
+	if (_softwareLine == nullptr)
+	{
+		_softwareLine.reset(new uint32_t[FRAME_WIDTH]);
+	}
+}
+
+void VideoBackend::RenderFrameSoftware(uint32_t buffer)
+{
+	const uint8_t* fb = reinterpret_cast<const uint8_t*>(_frameBufferSlots[buffer]);
+	FrameFormat format = _frameFormats[buffer];
+	uint32_t ntscPhase = _frameNtscPhases[buffer];
+
+	bool overscanEnabled = _overscanEnabled;
+	bool showingFps = _showingFps;
+	uint32_t currentFps = _currentFps;
+	float speedMultiplier = _speedMultiplier;
+
+	_softwarePlatform->UpdateSurfaceSize(&_windowWidth, &_windowHeight);
+
+	uint32_t pitch = 0;
+	uint32_t* surface = _softwarePlatform->GetSurface(&pitch);
+	if (surface == nullptr)
+	{
+		return;
+	}
+
+	uint32_t firstRow = overscanEnabled ? NUM_OVERSCAN_LINES / 2 : 0;
+	uint32_t height = overscanEnabled ? FRAME_HEIGHT - NUM_OVERSCAN_LINES : FRAME_HEIGHT;
+
+	// Whole number scales whenever the window is big enough, so every pixel comes out the same size
+	uint32_t scale = std::min(_windowWidth / FRAME_WIDTH, _windowHeight / height);
+	uint32_t outputWidth;
+	uint32_t outputHeight;
+
+	if (scale > 0)
+	{
+		outputWidth = FRAME_WIDTH * scale;
+		outputHeight = height * scale;
+	}
+	else if (_windowWidth * height < _windowHeight * FRAME_WIDTH)
+	{
+		outputWidth = _windowWidth;
+		outputHeight = std::max((_windowWidth * height) / FRAME_WIDTH, 1U);
+	}
+	else
+	{
+		outputWidth = std::max((_windowHeight * FRAME_WIDTH) / height, 1U);
+		outputHeight = _windowHeight;
+	}
+
+	uint32_t xOffset = (_windowWidth - outputWidth) / 2;
+	uint32_t yOffset = (_windowHeight - outputHeight) / 2;
+
+	// Letterboxing is cleared every frame since the OSD can be drawn over it
+	for (uint32_t y = 0; y < yOffset; ++y)
+	{
+		fillPixels(surface + (y * pitch), _windowWidth, 0);
+	}
+
+	for (uint32_t y = yOffset + outputHeight; y < _windowHeight; ++y)
+	{
+		fillPixels(surface + (y * pitch), _windowWidth, 0);
+	}
+
+	for (uint32_t y = 0; y < outputHeight;)
+	{
+		uint32_t row = firstRow + (scale > 0 ? y / scale : (y * height) / outputHeight);
+		const uint32_t* pixels = _softwareLine.get();
+
+		if (format == FrameFormat::Bgra)
+		{
+			pixels = reinterpret_cast<const uint32_t*>(fb) + (row * FRAME_WIDTH);
+		}
+		else if (format == FrameFormat::PaletteIndex)
+		{
+			const uint16_t* indices = reinterpret_cast<const uint16_t*>(fb) + (row * FRAME_WIDTH);
+			for (int32_t x = 0; x < FRAME_WIDTH; ++x)
+			{
+				_softwareLine[x] = _palette[indices[x] & 0x1FF];
+			}
+		}
+		else
+		{
+			// Each line is one step further along the carrier than the last
+			const uint16_t* indices = reinterpret_cast<const uint16_t*>(fb) + (row * FRAME_WIDTH);
+			_softwareNtsc->DecodeLine(indices, (ntscPhase + (row * 4)) % 12, _softwareLine.get());
+		}
+
+		uint32_t* dest = surface + ((yOffset + y) * pitch);
+		fillPixels(dest, xOffset, 0);
+		fillPixels(dest + xOffset + outputWidth, _windowWidth - xOffset - outputWidth, 0);
+		dest += xOffset;
+
+		if (scale > 0)
+		{
+			scaleRow(pixels, FRAME_WIDTH, scale, dest);
+
+			for (uint32_t i = 1; i < scale; ++i)
+			{
+				memcpy(dest + (i * pitch), dest, outputWidth * sizeof(uint32_t));
+			}
+
+			y += scale;
+		}
+		else
+		{
+			shrinkRow(pixels, FRAME_WIDTH, outputWidth, dest);
+			++y;
+		}
+	}
+
+	if (showingFps)
+	{
+		DrawFps(currentFps, speedMultiplier);
+	}
+
+	DrawMessages();
+	DrawOsdSoftware(surface, pitch);
+
+	_softwarePlatform->Present();
+}
+
+void VideoBackend::DrawOsdSoftware(uint32_t* surface, uint32_t pitch)
+{
+	size_t textCount = _osdTextCount;
+	_osdTextCount = 0;
+
+	for (size_t i = 0; i < textCount; ++i)
+	{
+		const OsdText& entry = _osdText[i];
+
+		// OSD positions are measured from the bottom of the window like in GL
+		int32_t top = static_cast<int32_t>(_windowHeight) - static_cast<int32_t>(entry.yPos + OSD_FONT_BITMAP_CELL_HEIGHT);
+
+		for (uint32_t c = 0; c < entry.text.length(); ++c)
+		{
+			uint32_t index = entry.text[c] - 32;
+			uint32_t col = index % 36;
+			uint32_t row = index / 36;
+
+			int32_t left = static_cast<int32_t>(entry.xPos + c * OSD_FONT_BITMAP_CELL_WIDTH);
+
+			for (uint32_t glyphY = 0; glyphY < OSD_FONT_BITMAP_CELL_HEIGHT; ++glyphY)
+			{
+				int32_t y = top + static_cast<int32_t>(glyphY);
+				if (y < 0 || y >= static_cast<int32_t>(_windowHeight))
+				{
+					continue;
+				}
+
+				// The font bitmap is stored bottom up as a GL texture
+				uint32_t bitmapRow = (OSD_FONT_BITMAP_HEIGHT - 1) - (row * OSD_FONT_BITMAP_CELL_HEIGHT + glyphY);
+				const unsigned char* source = OSD_FONT_BITMAP + ((bitmapRow * OSD_FONT_BITMAP_WIDTH) + (col * OSD_FONT_BITMAP_CELL_WIDTH)) * 3;
+				uint32_t* dest = surface + (y * pitch);
+
+				for (uint32_t glyphX = 0; glyphX < OSD_FONT_BITMAP_CELL_WIDTH; ++glyphX, source += 3)
+				{
+					int32_t x = left + static_cast<int32_t>(glyphX);
+					if (x < 0 || x >= static_cast<int32_t>(_windowWidth))
+					{
+						continue;
+					}
+
+					dest[x] = source[0] | (source[1] << 8) | (source[2] << 16);
+				}
+			}
+		}
+	}
+}
+
 void VideoBackend::UpdateSurfaceSize()
 {
 	_glPlatform->UpdateSurfaceSize(&_windowWidth, &_windowHeight);
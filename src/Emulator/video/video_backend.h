@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <future>
 #include <string>
 #include <mutex>
+#include <thread>
 #include <vector>
 #include <memory>
 
@@ -13,6 +18,8 @@
 #endif
 
 class IGLPlatform;
+class ISoftwarePlatform;
+class NtscDecoder;
 
 class VideoBackend
 {
@@ -20,28 +27,139 @@ public:
 	VideoBackend(void* windowHandle);
 	~VideoBackend();
 
+	enum class FrameFormat
+	{
+		Bgra,         // 32-bit BGRA pixels
+		PaletteIndex, // 16-bit colour indices with emphasis bits, expanded through the palette on the GPU
+		NtscIndex     // 16-bit colour indices with emphasis bits, NTSC decoded on the GPU
+	};
+
+	// 64 entry BGRA palette used to expand PaletteIndex frames. The entries for each
+	// combination of emphasis bits are derived from it. Must be set before Prepare.
+	void SetPalette(const uint32_t* palette);
+
+	// Draw frames on the CPU and put them on screen without going through OpenGL, for
+	// machines where software GL is slower than a plain blit. Must be set before Prepare.
+	void SetSoftwareRenderingEnabled(bool enabled);
+
+	// Render into an offscreen surface of the given size instead of the window, which
+	// can then be nullptr. For running on machines without a display, the presented
+	// frames can be read back with ReadPresentedFrame. Must be set before Prepare.
+	void SetOffscreenSurfaceSize(uint32_t width, uint32_t height);
+
+	// Wait for the display's vertical blank on every present. Must be set before Prepare.
+	void SetVsyncEnabled(bool enabled);
+
+	// Whether emulation should be paced by the display's refresh. That needs presents
+	// to actually be tied to it, which the platform has to support, and the refresh
+	// rate measured at startup to be close enough to the target frame rate for the
+	// audio to be resampled to match. Only valid once Prepare has returned.
+	bool IsVsyncActive();
+
+	// Frame rate the emulator is aiming for, relative to a nominal 60 fps the same as
+	// FramePacer. Decides whether IsVsyncActive holds.
+	void SetTargetFrameRate(uint32_t rate);
+
+	// Frame pacing for when vsync is active. Call after SubmitFrame, blocks until every
+	// frame before the one just submitted has been presented. Since each present waits
+	// for a vertical blank, this holds the emulator to the display's refresh rate while
+	// the render thread works one frame behind.
+	void WaitForVsync();
+
+	// Wait for the next frame to be presented to the offscreen surface and copy it out
+	// as 0x00RRGGBB pixels, top row first. Nothing is read back from the GPU unless
+	// asked for here. Returns false if no frame was presented within a second.
+	bool ReadPresentedFrame(std::vector<uint32_t>& pixels, uint32_t* width, uint32_t* height);
+
+	// Directory compiled shader programs are cached in so later runs can skip compiling
+	// them. Empty disables the cache. Must be set before Prepare.
+	void SetShaderCacheDirectory(const std::string& directory);
+
+	// Start the render thread and create the GL context on it. Any error setting
+	// up the context is rethrown here.
 	void Prepare();
 	void Finalize();
 
-	void SubmitFrame(uint8_t* fb);
+	// Frame buffer the emulator should draw the next frame into. Only valid until the
+	// next call to SubmitFrame, Prepare or Finalize. The buffer may be mapped GPU memory,
+	// so it should only ever be written to.
+	uint32_t* GetFrameBuffer();
+
+	// Hand the current frame buffer over to the render thread. Never blocks. For
+	// NtscIndex frames ntscPhase is the colour carrier phase (0, 4 or 8) of the
+	// first pixel of the frame, it is ignored otherwise.
+	//
+	// rowHashes optionally holds a hash of the contents of each of the 240 rows. Rows
+	// with the same hash as the ones last uploaded are assumed unchanged and skipped.
+	// Pass nullptr to upload the whole frame.
+	void SubmitFrame(FrameFormat format, uint32_t ntscPhase, const uint64_t* rowHashes);
 
 	void SetFps(uint32_t fps);
+	void SetSpeedMultiplier(float multiplier);
 	void ShowFps(bool show);
 	void ShowMessage(const std::string& message, uint32_t duration);
 	void SetOverscanEnabled(bool enabled);
 
 private:
-	void DrawFps(uint32_t fps);
+	void RenderLoop(std::promise<void> ready);
+	void InitializeRenderer();
+	void InitializeSoftwareRenderer();
+	void RenderFrameSoftware(uint32_t buffer);
+	void DrawOsdSoftware(uint32_t* surface, uint32_t pitch);
+	void RenderFrame(uint32_t buffer);
+	void UploadFrame(uint8_t* fb, uint32_t firstRow, uint32_t height, FrameFormat format, const uint64_t* rowHashes);
+	void DrawFps(uint32_t fps, float speedMultiplier);
 	void DrawMessages();
-	void DrawText(const std::string& text, uint32_t xPos, uint32_t yPos);
+	void DrawText(const std::string& text, uint32_t xPos, uint32_t yPos); // Queued until DrawOsd
+	void DrawOsd();
 	void UpdateSurfaceSize();
 	void SwapFrameBuffers();
+	void CapturePresentedFrame();
+	void MapPersistentFrameBuffers();
+	void UnmapPersistentFrameBuffers();
+	void WaitForFrameUpload(uint32_t buffer);
+	void MeasureRefreshRate();
+	void FramePresented(uint32_t buffer);
 	
-	bool _overscanEnabled;
-	bool _showingFps;
+	void* _windowHandle;
+	bool _softwareRendering;
+	bool _vsyncEnabled;
+	std::atomic<bool> _vsyncActive; // Presents wait for the vertical blank
+	double _refreshRate; // Measured on the render thread before Prepare returns
+	std::atomic<uint32_t> _targetFrameRate;
+
+	std::atomic<bool> _overscanEnabled;
+	std::atomic<bool> _showingFps;
 	uint32_t _windowWidth;
 	uint32_t _windowHeight;
-	uint32_t _currentFps;
+	std::atomic<uint32_t> _currentFps;
+	std::atomic<float> _speedMultiplier;
+
+	// Triple buffered frame handoff. The emulation thread owns the back buffer and the
+	// render thread owns the present buffer, the third is swapped in and out by either
+	// side. The FRAME_READY bit is set on the shared index when it holds a new frame.
+	std::unique_ptr<uint32_t[]> _frameBuffers;
+	uint32_t* _frameBufferSlots[3];
+	FrameFormat _frameFormats[3];
+	uint32_t _frameNtscPhases[3];
+	uint64_t _frameRowHashes[3][240];
+	bool _frameRowHashesValid[3];
+	uint64_t _frameSequences[3];
+	uint32_t _backBuffer;
+	uint32_t _presentBuffer;
+	std::atomic<uint32_t> _sharedBuffer;
+
+	std::thread _renderThread;
+	std::atomic<bool> _rendering;
+	std::mutex _frameMutex;
+	std::condition_variable _frameCv;
+
+	// Sequence numbers of the last frame submitted and the last frame presented. Frames
+	// the render thread never got to are skipped over, so presented can jump.
+	uint64_t _framesSubmitted;
+	uint64_t _framesPresented;
+	std::mutex _presentMutex;
+	std::condition_variable _presentCv;
 
 	std::mutex _messageMutex;
 	std::vector<std::pair<std::string, std::chrono::steady_clock::time_point> > _messages;
@@ -50,10 +168,77 @@ private:
 	GLuint _frameVertexArrayId;
 	GLuint _frameVertexBuffer;
 	GLuint _frameTextureId;
+	GLint _frameSamplerLocation;
+	uint32_t _frameTextureHeight;
+	FrameFormat _frameTextureFormat;
+
+	// Row hashes of the frame currently in the texture and the spans of rows that differ
+	// from the frame being uploaded
+	uint64_t _textureRowHashes[240];
+	bool _textureRowHashesValid;
+	std::vector<std::pair<uint32_t, uint32_t> > _dirtyRows;
+	GLuint _paletteProgramId;
+	GLuint _ntscProgramId;
+	GLuint _paletteTextureId;
+	uint32_t _palette[512]; // 8 rows of 64 colours, one for each combination of emphasis bits
+	std::string _shaderCacheDirectory;
 	GLuint _textProgramId;
 	GLuint _textTextureId;
+	GLint _textSamplerLocation;
 	GLuint _textVertexBuffer;
-	GLuint _textUVBuffer;
+
+	// All of the OSD text is drawn in one batch. The geometry for it is only rebuilt when
+	// some string or its position differs from the last frame, which in practice is when
+	// the FPS counter ticks over or a message comes or goes.
+	struct OsdText
+	{
+		std::string text;
+		uint32_t xPos;
+		uint32_t yPos;
+
+		bool operator==(const OsdText& other) const
+		{
+			return xPos == other.xPos && yPos == other.yPos && text == other.text;
+		}
+	};
+
+	std::vector<OsdText> _osdText;
+	size_t _osdTextCount;
+	std::vector<OsdText> _drawnOsdText;
+	std::vector<float> _osdGeometry;
+	GLsizei _osdVertexCount;
+
+	// Frames are copied into a ring of pixel buffer objects and uploaded to the texture from
+	// there so the copy to the GPU happens asynchronously. A fence on each buffer makes sure
+	// the upload out of it has finished before it's written to again.
+	static constexpr uint32_t NUM_UPLOAD_BUFFERS = 3;
+
+	bool _pboUploadsSupported;
+	bool _fencesSupported;
+	uint32_t _nextUploadBuffer;
+	GLuint _uploadBuffers[NUM_UPLOAD_BUFFERS];
+	GLsync _uploadFences[NUM_UPLOAD_BUFFERS];
+
+	// Where the driver supports it the triple buffer itself lives in a persistently mapped
+	// buffer, so the emulator draws straight into memory the GPU uploads from and there's
+	// no copy at all. A fence on each slot holds it back from the emulator until the GPU
+	// is done reading it.
+	GLuint _persistentFrameBuffer;
+	uint8_t* _persistentFrameMapping;
+	GLsync _frameFences[3];
 
 	std::unique_ptr<IGLPlatform> _glPlatform;
+
+	uint32_t _offscreenWidth;
+	uint32_t _offscreenHeight;
+	std::mutex _captureMutex;
+	std::condition_variable _captureCv;
+	bool _captureRequested;
+	std::vector<uint32_t> _capturedFrame; // Bottom row first, as it comes from glReadPixels
+	uint32_t _capturedWidth;
+	uint32_t _capturedHeight;
+
+	std::unique_ptr<ISoftwarePlatform> _softwarePlatform;
+	std::unique_ptr<NtscDecoder> _softwareNtsc;
+	std::unique_ptr<uint32_t[]> _softwareLine;
 };
\ No newline at end of file
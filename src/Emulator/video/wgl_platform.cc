@@ -71,6 +71,19 @@ void WGLPlatform::SwapBuffers()
 	::SwapBuffers(_windowDc);
 }
 
+bool WGLPlatform::SetSwapInterval(int interval)
+{
+	typedef BOOL (WINAPI *SwapIntervalEXT)(int);
+
+	SwapIntervalEXT swapInterval = reinterpret_cast<SwapIntervalEXT>(wglGetProcAddress("wglSwapIntervalEXT"));
+	if (swapInterval == nullptr)
+	{
+		return false;
+	}
+
+	return swapInterval(interval) == TRUE;
+}
+
 void WGLPlatform::UpdateSurfaceSize(uint32_t* width, uint32_t* height)
 {
 	RECT rect;
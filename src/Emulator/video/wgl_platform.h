@@ -13,6 +13,7 @@ public:
 	virtual void DestroyWindow() override;
 	virtual void DestroyContext() override;
 	virtual void SwapBuffers() override;
+	virtual bool SetSwapInterval(int interval) override;
 	virtual void UpdateSurfaceSize(uint32_t* width, uint32_t* height) override;
 
 private:
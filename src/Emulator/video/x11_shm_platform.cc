@@ -0,0 +1,290 @@
+#if defined(__linux)
+
+#include <cstdlib>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "x11_shm_platform.h"
+#include "nes_exception.h"
+
+// For XESetError. Last, since it defines min and max macros.
+#include <X11/Xlibint.h>
+#include <X11/extensions/shmproto.h>
+
+namespace
+{
+bool shmAttachFailed = false;
+
+// Hooked into this platform's own display connection only, so unlike a process wide
+// error handler it can't race with or swallow errors from the toolkit's connection.
+// Returning True keeps the error from reaching the regular handler.
+int handleShmAttachError(Display*, xError* error, XExtCodes* codes, int*)
+{
+	if (error->majorCode != codes->major_opcode || error->minorCode != X_ShmAttach)
+	{
+		return False;
+	}
+
+	shmAttachFailed = true;
+	return True;
+}
+}
+
+X11ShmPlatform::X11ShmPlatform()
+	: _display(nullptr)
+	, _parentWindowHandle(0)
+	, _windowHandle(0)
+	, _colorMap(0)
+	, _gc(nullptr)
+	, _shmSupported(false)
+	, _image(nullptr)
+	, _imageShared(false)
+	, _width(0)
+	, _height(0)
+{
+}
+
+void X11ShmPlatform::InitializeWindow(void* windowHandle)
+{
+	_parentWindowHandle = reinterpret_cast<Window>(windowHandle);
+	_display = XOpenDisplay(nullptr);
+
+	if (_display == nullptr)
+	{
+		throw NesException("X11ShmPlatform", "Failed to connect to X11 Display");
+	}
+
+	XWindowAttributes attributes;
+	if (XGetWindowAttributes(_display, _parentWindowHandle, &attributes) == 0)
+	{
+		XCloseDisplay(_display);
+		throw NesException("X11ShmPlatform", "Failed to retrieve X11 window attributes");
+	}
+
+	// Frames are BGRA, which is what a 24-bit TrueColor visual looks like in memory
+	bool visualFound = XMatchVisualInfo(_display, DefaultScreen(_display), 24, TrueColor, &_visualInfo) != 0;
+	if (!visualFound || _visualInfo.red_mask != 0xFF0000 || _visualInfo.green_mask != 0x00FF00 || _visualInfo.blue_mask != 0x0000FF)
+	{
+		XCloseDisplay(_display);
+		throw NesException("X11ShmPlatform", "Failed to find a 24-bit TrueColor visual");
+	}
+
+	_colorMap = XCreateColormap(_display, _parentWindowHandle, _visualInfo.visual, AllocNone);
+
+	XSetWindowAttributes setWindowAttributes;
+	setWindowAttributes.colormap = _colorMap;
+	setWindowAttributes.border_pixel = 0;
+	setWindowAttributes.background_pixel = 0;
+
+	_windowHandle = XCreateWindow(_display, _parentWindowHandle, 0, 0, attributes.width, attributes.height, 0, _visualInfo.depth,
+							InputOutput, _visualInfo.visual, CWColormap | CWBorderPixel | CWBackPixel, &setWindowAttributes);
+
+	if (XMapWindow(_display, _windowHandle) == 0)
+	{
+		XDestroyWindow(_display, _windowHandle);
+		XFreeColormap(_display, _colorMap);
+		XCloseDisplay(_display);
+		throw NesException("X11ShmPlatform", "Failed to map X11 window");
+	}
+
+	_gc = XCreateGC(_display, _windowHandle, 0, nullptr);
+
+	int major, minor;
+	Bool sharedPixmaps;
+	_shmSupported = XShmQueryVersion(_display, &major, &minor, &sharedPixmaps) == True;
+
+	if (_shmSupported)
+	{
+		// A server that can't get at our memory (a remote display for instance) only
+		// reports a failed attach asynchronously. Catch it on this connection instead of
+		// letting it go to the default handler, which exits the process.
+		XExtCodes* codes = XInitExtension(_display, SHMNAME);
+		if (codes != nullptr)
+		{
+			XESetError(_display, codes->extension, handleShmAttachError);
+		}
+		else
+		{
+			_shmSupported = false;
+		}
+	}
+}
+
+void X11ShmPlatform::DestroyWindow()
+{
+	DestroyImage();
+
+	XFreeGC(_display, _gc);
+	XDestroyWindow(_display, _windowHandle);
+	XFreeColormap(_display, _colorMap);
+	XCloseDisplay(_display);
+}
+
+void X11ShmPlatform::UpdateSurfaceSize(uint32_t* width, uint32_t* height)
+{
+	XWindowAttributes attributes;
+	if (XGetWindowAttributes(_display, _parentWindowHandle, &attributes) == 0)
+	{
+		return;
+	}
+
+	uint32_t newWidth = static_cast<uint32_t>(attributes.width);
+	uint32_t newHeight = static_cast<uint32_t>(attributes.height);
+
+	if (*width != newWidth || *height != newHeight)
+	{
+		*width = attributes.width;
+		*height = attributes.height;
+
+		XResizeWindow(_display, _windowHandle, *width, *height);
+	}
+
+	_width = *width;
+	_height = *height;
+}
+
+uint32_t* X11ShmPlatform::GetSurface(uint32_t* pitch)
+{
+	if (_width == 0 || _height == 0)
+	{
+		return nullptr;
+	}
+
+	if (_image == nullptr || static_cast<uint32_t>(_image->width) != _width || static_cast<uint32_t>(_image->height) != _height)
+	{
+		DestroyImage();
+		CreateImage(_width, _height);
+	}
+
+	*pitch = _image->bytes_per_line / sizeof(uint32_t);
+	return reinterpret_cast<uint32_t*>(_image->data);
+}
+
+void X11ShmPlatform::Present()
+{
+	if (_image == nullptr)
+	{
+		return;
+	}
+
+	if (_imageShared)
+	{
+		XShmPutImage(_display, _windowHandle, _gc, _image, 0, 0, 0, 0, _image->width, _image->height, False);
+	}
+	else
+	{
+		XPutImage(_display, _windowHandle, _gc, _image, 0, 0, 0, 0, _image->width, _image->height);
+	}
+
+	// The server reads a shared image asynchronously, it has to be done before the next frame is drawn into it
+	XSync(_display, False);
+}
+
+void X11ShmPlatform::CreateImage(uint32_t width, uint32_t height)
+{
+	if (_shmSupported && CreateSharedImage(width, height))
+	{
+		return;
+	}
+
+	_image = XCreateImage(_display, _visualInfo.visual, _visualInfo.depth, ZPixmap, 0, nullptr, width, height, 32, 0);
+	if (_image == nullptr)
+	{
+		throw NesException("X11ShmPlatform", "Failed to create X11 image");
+	}
+
+	if (_image->bits_per_pixel != 32)
+	{
+		XDestroyImage(_image);
+		_image = nullptr;
+		throw NesException("X11ShmPlatform", "X11 image is not 32 bits per pixel");
+	}
+
+	// Freed by XDestroyImage
+	_image->data = static_cast<char*>(malloc(_image->bytes_per_line * _image->height));
+	_imageShared = false;
+}
+
+bool X11ShmPlatform::CreateSharedImage(uint32_t width, uint32_t height)
+{
+	_image = XShmCreateImage(_display, _visualInfo.visual, _visualInfo.depth, ZPixmap, nullptr, &_shmInfo, width, height);
+	if (_image == nullptr)
+	{
+		return false;
+	}
+
+	if (_image->bits_per_pixel != 32)
+	{
+		XDestroyImage(_image);
+		_image = nullptr;
+		return false;
+	}
+
+	_shmInfo.shmid = shmget(IPC_PRIVATE, _image->bytes_per_line * _image->height, IPC_CREAT | 0600);
+	if (_shmInfo.shmid < 0)
+	{
+		XDestroyImage(_image);
+		_image = nullptr;
+		return false;
+	}
+
+	_shmInfo.shmaddr = static_cast<char*>(shmat(_shmInfo.shmid, nullptr, 0));
+	if (_shmInfo.shmaddr == reinterpret_cast<char*>(-1))
+	{
+		shmctl(_shmInfo.shmid, IPC_RMID, nullptr);
+		XDestroyImage(_image);
+		_image = nullptr;
+		return false;
+	}
+
+	_image->data = _shmInfo.shmaddr;
+	_shmInfo.readOnly = False;
+
+	// Any failure comes back through handleShmAttachError once the server has seen this
+	shmAttachFailed = false;
+	XShmAttach(_display, &_shmInfo);
+	XSync(_display, False);
+
+	// Marked for removal right away so the segment can't outlive the process
+	shmctl(_shmInfo.shmid, IPC_RMID, nullptr);
+
+	if (shmAttachFailed)
+	{
+		shmdt(_shmInfo.shmaddr);
+		XDestroyImage(_image);
+		_image = nullptr;
+
+		// No point trying again on every resize
+		_shmSupported = false;
+		return false;
+	}
+
+	_imageShared = true;
+	return true;
+}
+
+void X11ShmPlatform::DestroyImage()
+{
+	if (_image == nullptr)
+	{
+		return;
+	}
+
+	if (_imageShared)
+	{
+		// Shared images don't own their data, the segment is detached separately
+		XShmDetach(_display, &_shmInfo);
+		XSync(_display, False);
+		XDestroyImage(_image);
+		shmdt(_shmInfo.shmaddr);
+	}
+	else
+	{
+		XDestroyImage(_image);
+	}
+
+	_image = nullptr;
+	_imageShared = false;
+}
+
+#endif
\ No newline at end of file
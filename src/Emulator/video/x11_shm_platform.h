@@ -0,0 +1,45 @@
+#pragma once
+
+#if defined(__linux)
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+#include "isoftware_platform.h"
+
+// Software presenter for X11. Frames go through an MIT-SHM shared memory image when the
+// server supports it so they aren't copied over the socket, which is the case for any
+// local server including Xvfb. Falls back to a plain XPutImage otherwise.
+class X11ShmPlatform : public ISoftwarePlatform
+{
+public:
+	X11ShmPlatform();
+
+	virtual void InitializeWindow(void* windowHandle);
+	virtual void DestroyWindow();
+	virtual void UpdateSurfaceSize(uint32_t* width, uint32_t* height);
+	virtual uint32_t* GetSurface(uint32_t* pitch);
+	virtual void Present();
+
+private:
+	void CreateImage(uint32_t width, uint32_t height);
+	bool CreateSharedImage(uint32_t width, uint32_t height);
+	void DestroyImage();
+
+	Display* _display;
+	Window _parentWindowHandle;
+	Window _windowHandle;
+	XVisualInfo _visualInfo;
+	Colormap _colorMap;
+	GC _gc;
+
+	bool _shmSupported;
+	XImage* _image;
+	XShmSegmentInfo _shmInfo;
+	bool _imageShared;
+	uint32_t _width;
+	uint32_t _height;
+};
+
+#endif
\ No newline at end of file
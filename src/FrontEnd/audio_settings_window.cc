@@ -4,6 +4,7 @@
 #include <wx/checkbox.h>
 #include <wx/statbox.h>
 #include <wx/slider.h>
+#include <wx/spinctrl.h>
 
 #include "main_window.h"
 #include "audio_settings_window.h"
@@ -15,9 +16,12 @@ wxDEFINE_EVENT(EVT_AUDIO_WINDOW_CLOSED, wxCommandEvent);
 
 AudioSettingsWindow::AudioSettingsWindow(MainWindow* parent, std::unique_ptr<NES>& nes)
     : SettingsWindowBase(parent, nes, "Audio Settings")
+    , StatisticsTimer(this, ID_STATISTICS_TIMER)
 {
     InitializeLayout();
     BindEvents();
+
+    StatisticsTimer.Start(500);
 }
 
 void AudioSettingsWindow::InitializeLayout()
@@ -108,7 +112,26 @@ void AudioSettingsWindow::InitializeLayout()
 
     otherSizer->Add(EnableAudioCheckBox);
 
+    int periodLength, periods;
+    settings.Read("/Audio/PeriodLength", &periodLength);
+    settings.Read("/Audio/Periods", &periods);
+
+    PeriodLength = new wxSpinCtrl(SettingsPanel, wxID_ANY, "", wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 1, 50, periodLength);
+    Periods = new wxSpinCtrl(SettingsPanel, wxID_ANY, "", wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 2, 16, periods);
+    Statistics = new wxStaticText(SettingsPanel, wxID_ANY, "");
+
+    wxFlexGridSizer* latencyGrid = new wxFlexGridSizer(2, 5, 5);
+    latencyGrid->Add(new wxStaticText(SettingsPanel, wxID_ANY, "Period Length (ms)"), wxSizerFlags().Align(wxALIGN_CENTER_VERTICAL));
+    latencyGrid->Add(PeriodLength);
+    latencyGrid->Add(new wxStaticText(SettingsPanel, wxID_ANY, "Periods"), wxSizerFlags().Align(wxALIGN_CENTER_VERTICAL));
+    latencyGrid->Add(Periods);
+
+    wxStaticBoxSizer* latencyBox = new wxStaticBoxSizer(wxVERTICAL, SettingsPanel, "Latency (Takes Effect Next Game)");
+    latencyBox->Add(latencyGrid, wxSizerFlags().Border(wxALL, 5));
+    latencyBox->Add(Statistics, wxSizerFlags().Expand().Border(wxLEFT | wxRIGHT | wxBOTTOM, 5));
+
     volumeSizer->Add(channelBox, wxSizerFlags().Expand().Border(wxALL, 10));
+    volumeSizer->Add(latencyBox, wxSizerFlags().Expand().Border(wxLEFT | wxRIGHT | wxBOTTOM, 10));
     volumeSizer->Add(otherSizer, wxSizerFlags().Expand().Border(wxLEFT | wxRIGHT | wxBOTTOM, 10));
     SettingsPanel->SetSizer(volumeSizer);
 
@@ -124,6 +147,7 @@ void AudioSettingsWindow::BindEvents()
     Bind(wxEVT_SLIDER, &AudioSettingsWindow::TriangleVolumeChanged, this, ID_TRIANGLE_SLIDER);
     Bind(wxEVT_SLIDER, &AudioSettingsWindow::NoiseVolumeChanged, this, ID_NOISE_SLIDER);
     Bind(wxEVT_SLIDER, &AudioSettingsWindow::DmcVolumeChanged, this, ID_DMC_SLIDER);
+    Bind(wxEVT_TIMER, &AudioSettingsWindow::UpdateStatistics, this, ID_STATISTICS_TIMER);
 }
 
 void AudioSettingsWindow::DoClose()
@@ -145,17 +169,27 @@ void AudioSettingsWindow::DoOk()
     settings.Write("/Audio/DmcVolume", DmcVolume->GetValue());
 
     settings.Write("/Audio/Enabled", EnableAudioCheckBox->GetValue());
+    settings.Write("/Audio/PeriodLength", PeriodLength->GetValue());
+    settings.Write("/Audio/Periods", Periods->GetValue());
 
     Close();
 }
 
 void AudioSettingsWindow::DoCancel()
 {
+    AppSettings& settings = AppSettings::GetInstance();
+
+    int periodLength, periods;
+    settings.Read("/Audio/PeriodLength", &periodLength);
+    settings.Read("/Audio/Periods", &periods);
+
+    // Only read when a game starts, so just put the controls back
+    PeriodLength->SetValue(periodLength);
+    Periods->SetValue(periods);
+
     // Reset settings on cancel
     if (Nes != nullptr)
     {
-        AppSettings& settings = AppSettings::GetInstance();
-
         bool audioEnabled;
         settings.Read("/Audio/Enabled", &audioEnabled);
 
@@ -247,3 +281,26 @@ void AudioSettingsWindow::DmcVolumeChanged(wxCommandEvent& event)
 
     CurrentDmcVolume->SetLabel(std::to_string(DmcVolume->GetValue()));
 }
+
+void AudioSettingsWindow::UpdateStatistics(wxTimerEvent& WXUNUSED(event))
+{
+    if (Nes == nullptr)
+    {
+        Statistics->SetLabel("No game running");
+        return;
+    }
+
+    AudioStatistics statistics = Nes->GetAudioStatistics();
+
+    auto toMilliseconds = [&statistics](uint32_t samples)
+    {
+        return statistics.sampleRate == 0 ? 0.0 : (samples * 1000.0) / statistics.sampleRate;
+    };
+
+    Statistics->SetLabel(wxString::Format("Underruns: %u    Delay: %.1f ms    Buffer: %.1f / %.1f ms    Queued: %.1f ms",
+        statistics.underruns,
+        toMilliseconds(statistics.deviceDelay),
+        toMilliseconds(statistics.deviceBufferFill),
+        toMilliseconds(statistics.deviceBufferSize),
+        toMilliseconds(statistics.queuedSamples)));
+}
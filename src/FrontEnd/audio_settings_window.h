@@ -1,5 +1,7 @@
 #pragma once
 
+#include <wx/timer.h>
+
 #include "settings_window_base.h"
 
 class NES;
@@ -7,6 +9,7 @@ class MainWindow;
 class wxSlider;
 class wxCheckBox;
 class wxStaticText;
+class wxSpinCtrl;
 
 wxDECLARE_EVENT(EVT_AUDIO_WINDOW_CLOSED, wxCommandEvent);
 
@@ -31,6 +34,7 @@ private:
     void TriangleVolumeChanged(wxCommandEvent& event);
     void NoiseVolumeChanged(wxCommandEvent& event);
     void DmcVolumeChanged(wxCommandEvent& event);
+    void UpdateStatistics(wxTimerEvent& event);
 
     wxSlider* MasterVolume;
     wxSlider* PulseOneVolume;
@@ -46,6 +50,11 @@ private:
     wxStaticText* CurrentDmcVolume;
 
     wxCheckBox* EnableAudioCheckBox;
+
+    wxSpinCtrl* PeriodLength;
+    wxSpinCtrl* Periods;
+    wxStaticText* Statistics;
+    wxTimer StatisticsTimer;
 };
 
 const int ID_AUDIO_ENABLED = 200;
@@ -56,3 +65,4 @@ const int ID_PULSE_TWO_SLIDER = 204;
 const int ID_TRIANGLE_SLIDER = 205;
 const int ID_NOISE_SLIDER = 206;
 const int ID_DMC_SLIDER = 207;
+const int ID_STATISTICS_TIMER = 208;
@@ -121,9 +121,10 @@ void MainWindow::StartEmulator(const std::string& filename)
 
         AppSettings& appSettings = AppSettings::GetInstance();
 
-        wxString nativeSavePath, stateSavePath;
+        wxString nativeSavePath, stateSavePath, shaderCachePath;
         appSettings.Read("/Paths/NativeSavePath", &nativeSavePath);
         appSettings.Read("/Paths/StateSavePath", &stateSavePath);
+        appSettings.Read("/Paths/ShaderCachePath", &shaderCachePath);
 
         if (!wxDir::Exists(nativeSavePath))
         {
@@ -135,18 +136,30 @@ void MainWindow::StartEmulator(const std::string& filename)
             wxDir::Make(stateSavePath, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
         }
 
+        if (!wxDir::Exists(shaderCachePath))
+        {
+            wxDir::Make(shaderCachePath, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
+        }
+
         try
         {
             Nes = std::make_unique<NES>(filename, nativeSavePath.ToStdString(), windowHandle, this);
 
             Nes->SetCpuLogEnabled(SettingsMenu->FindItem(ID_CPU_LOG)->IsChecked());
             Nes->SetTurboModeEnabled(SettingsMenu->FindItem(ID_FRAME_LIMIT)->IsChecked());
+            Nes->SetMaxSpeedModeEnabled(SettingsMenu->FindItem(ID_MAX_SPEED)->IsChecked());
 
             bool audioEnabled;
             appSettings.Read("/Audio/Enabled", &audioEnabled);
 
             Nes->SetAudioEnabled(audioEnabled);
 
+            int periodLength, periods;
+            appSettings.Read("/Audio/PeriodLength", &periodLength);
+            appSettings.Read("/Audio/Periods", &periods);
+
+            Nes->SetAudioLatency(periodLength, periods);
+
             int master, pulseOne, pulseTwo, triangle, noise, dmc;
             appSettings.Read("/Audio/MasterVolume", &master);
             appSettings.Read("/Audio/PulseOneVolume", &pulseOne);
@@ -163,16 +176,33 @@ void MainWindow::StartEmulator(const std::string& filename)
             Nes->SetDmcVolume(dmc / 100.f);
 
 
-            bool fpsEnabled, overscanEnabled, ntscDecodingEnabled;
+            bool fpsEnabled, overscanEnabled, ntscDecodingEnabled, gpuPaletteEnabled, softwareRenderingEnabled, vsyncEnabled;
             appSettings.Read("/Video/ShowFps", &fpsEnabled);
             appSettings.Read("/Video/Overscan", &overscanEnabled);
             appSettings.Read("/Video/NtscDecoding", &ntscDecodingEnabled);
+            appSettings.Read("/Video/GpuPalette", &gpuPaletteEnabled);
+            appSettings.Read("/Video/SoftwareRendering", &softwareRenderingEnabled);
+            appSettings.Read("/Video/Vsync", &vsyncEnabled);
 
             Nes->SetFpsDisplayEnabled(fpsEnabled);
             Nes->SetOverscanEnabled(overscanEnabled);
             Nes->SetNtscDecoderEnabled(ntscDecodingEnabled);
+            Nes->SetGpuPaletteEnabled(gpuPaletteEnabled);
+            Nes->SetSoftwareRenderingEnabled(softwareRenderingEnabled);
+            Nes->SetVsyncEnabled(vsyncEnabled);
+
+            int turboFrameSkip;
+            appSettings.Read("/Video/TurboFrameSkip", &turboFrameSkip);
+
+            Nes->SetTurboFrameSkip(turboFrameSkip);
+
+            bool limitMaxSpeedPresent;
+            appSettings.Read("/Video/LimitMaxSpeedPresent", &limitMaxSpeedPresent);
+
+            Nes->SetMaxSpeedPresentRate(limitMaxSpeedPresent ? 60 : 0);
 
             Nes->SetStateSaveDirectory(stateSavePath.ToStdString());
+            Nes->SetShaderCacheDirectory(shaderCachePath.ToStdString());
         }
         catch (NesException& e)
         {
@@ -259,6 +289,15 @@ void MainWindow::ToggleFrameLimit(wxCommandEvent& event)
     }
 }
 
+void MainWindow::ToggleMaxSpeed(wxCommandEvent& WXUNUSED(event))
+{
+    if (Nes != nullptr)
+    {
+        bool enabled = SettingsMenu->FindItem(ID_MAX_SPEED)->IsChecked();
+        Nes->SetMaxSpeedModeEnabled(enabled);
+    }
+}
+
 void MainWindow::OnROMDoubleClick(wxListEvent& event)
 {
     AppSettings& settings = AppSettings::GetInstance();
@@ -562,6 +601,7 @@ void MainWindow::InitializeMenus()
     SettingsMenu = new wxMenu;
     SettingsMenu->AppendCheckItem(ID_CPU_LOG, wxT("&Enable CPU Log"));
     SettingsMenu->AppendCheckItem(ID_FRAME_LIMIT, wxT("&Enable Turbo Mode"));
+    SettingsMenu->AppendCheckItem(ID_MAX_SPEED, wxT("Enable &Maximum Speed"));
     SettingsMenu->AppendSeparator();
     SettingsMenu->Append(ID_SETTINGS_AUDIO, wxT("&Audio Settings"));
     SettingsMenu->Append(ID_SETTINGS_VIDEO, wxT("&Video Settings"));
@@ -627,6 +667,7 @@ void MainWindow::BindEvents()
     Bind(wxEVT_COMMAND_MENU_SELECTED, wxCommandEventHandler(MainWindow::OnEmulatorSuspendResume), this, ID_EMULATOR_SUSPEND_RESUME);
     Bind(wxEVT_COMMAND_MENU_SELECTED, wxCommandEventHandler(MainWindow::OpenPpuViewer), this, ID_EMULATOR_PPU_DEBUG);
     Bind(wxEVT_COMMAND_MENU_SELECTED, wxCommandEventHandler(MainWindow::ToggleFrameLimit), this, ID_FRAME_LIMIT);
+    Bind(wxEVT_COMMAND_MENU_SELECTED, wxCommandEventHandler(MainWindow::ToggleMaxSpeed), this, ID_MAX_SPEED);
 
     Bind(wxEVT_COMMAND_MENU_SELECTED, wxCommandEventHandler(MainWindow::OnSaveState), this, ID_STATE_SAVE_1);
     Bind(wxEVT_COMMAND_MENU_SELECTED, wxCommandEventHandler(MainWindow::OnSaveState), this, ID_STATE_SAVE_2);
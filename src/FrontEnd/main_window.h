@@ -78,6 +78,7 @@ private:
 
     void ToggleCPULog(wxCommandEvent& event);
     void ToggleFrameLimit(wxCommandEvent& event);
+    void ToggleMaxSpeed(wxCommandEvent& event);
     void OnROMDoubleClick(wxListEvent& event);
     void OnOpenROM(wxCommandEvent& event);
     void OnEmulatorSuspendResume(wxCommandEvent& event);
@@ -145,3 +146,4 @@ const int ID_STATE_LOAD_7 = 126;
 const int ID_STATE_LOAD_8 = 127;
 const int ID_STATE_LOAD_9 = 128;
 const int ID_STATE_LOAD_10 = 129;
+const int ID_MAX_SPEED = 130;
@@ -42,6 +42,12 @@ AppSettings::AppSettings()
         Settings->Write("/Paths/StateSavePath", file.GetFullPath());
     }
 
+    if (!Settings->HasEntry("/Paths/ShaderCachePath"))
+    {
+        wxFileName file(wxGetCwd() + "/cache", "shaders");
+        Settings->Write("/Paths/ShaderCachePath", file.GetFullPath());
+    }
+
     if (!Settings->HasEntry("/Audio/Enabled"))
     {
         Settings->Write("/Audio/Enabled", true);
@@ -77,6 +83,16 @@ AppSettings::AppSettings()
         Settings->Write("/Audio/DmcVolume", 100);
     }
 
+    if (!Settings->HasEntry("/Audio/PeriodLength"))
+    {
+        Settings->Write("/Audio/PeriodLength", 4);
+    }
+
+    if (!Settings->HasEntry("/Audio/Periods"))
+    {
+        Settings->Write("/Audio/Periods", 4);
+    }
+
     if (!Settings->HasEntry("/Video/Resolution"))
     {
         Settings->Write("/Video/Resolution", 0);
@@ -87,6 +103,21 @@ AppSettings::AppSettings()
         Settings->Write("/Video/NtscDecoding", false);
     }
 
+    if (!Settings->HasEntry("/Video/GpuPalette"))
+    {
+        Settings->Write("/Video/GpuPalette", false);
+    }
+
+    if (!Settings->HasEntry("/Video/SoftwareRendering"))
+    {
+        Settings->Write("/Video/SoftwareRendering", false);
+    }
+
+    if (!Settings->HasEntry("/Video/Vsync"))
+    {
+        Settings->Write("/Video/Vsync", false);
+    }
+
     if (!Settings->HasEntry("/Video/Overscan"))
     {
         Settings->Write("/Video/Overscan", true);
@@ -97,6 +128,16 @@ AppSettings::AppSettings()
         Settings->Write("/Video/ShowFps", false);
     }
 
+    if (!Settings->HasEntry("/Video/TurboFrameSkip"))
+    {
+        Settings->Write("/Video/TurboFrameSkip", 20);
+    }
+
+    if (!Settings->HasEntry("/Video/LimitMaxSpeedPresent"))
+    {
+        Settings->Write("/Video/LimitMaxSpeedPresent", true);
+    }
+
     if (!Settings->HasEntry("/Menu/Width"))
     {
         Settings->Write("/Menu/Width", 600);
@@ -2,6 +2,8 @@
 #include <wx/combobox.h>
 #include <wx/statbox.h>
 #include <wx/checkbox.h>
+#include <wx/spinctrl.h>
+#include <wx/stattext.h>
 #include <wx/sizer.h>
 #include <vector>
 
@@ -37,25 +39,51 @@ void VideoSettingsWindow::InitializeLayout()
     ResolutionComboBox->SetSelection(currentChoice);
 
     EnableNtscDecoding = new wxCheckBox(SettingsPanel, ID_NTSC_ENABLED, "Enable NTCS Decoding");
+    EnableGpuPalette = new wxCheckBox(SettingsPanel, ID_GPU_PALETTE_ENABLED, "Decode Colours on GPU");
     EnableOverscan = new wxCheckBox(SettingsPanel, ID_OVERSCAN_ENABLED, "Enable Overscan");
     ShowFpsCounter = new wxCheckBox(SettingsPanel, ID_SHOW_FPS_COUNTER, "Show FPS");
+    LimitMaxSpeedPresent = new wxCheckBox(SettingsPanel, ID_LIMIT_MAX_SPEED_PRESENT, "Limit Maximum Speed Redraws to 60 FPS");
+    EnableSoftwareRendering = new wxCheckBox(SettingsPanel, ID_SOFTWARE_RENDERING_ENABLED, "Software Rendering (Takes Effect Next Game)");
+    EnableVsync = new wxCheckBox(SettingsPanel, ID_VSYNC_ENABLED, "Sync to Display Refresh (Takes Effect Next Game)");
 
-    bool ntscDecoding, overscan, showFps;
+    bool ntscDecoding, gpuPalette, overscan, showFps, limitMaxSpeedPresent, softwareRendering, vsync;
     settings.Read("/Video/NtscDecoding", &ntscDecoding);
+    settings.Read("/Video/GpuPalette", &gpuPalette);
     settings.Read("/Video/Overscan", &overscan);
     settings.Read("/Video/ShowFps", &showFps);
+    settings.Read("/Video/LimitMaxSpeedPresent", &limitMaxSpeedPresent);
+    settings.Read("/Video/SoftwareRendering", &softwareRendering);
+    settings.Read("/Video/Vsync", &vsync);
 
     EnableNtscDecoding->SetValue(ntscDecoding);
+    EnableGpuPalette->SetValue(gpuPalette);
     EnableOverscan->SetValue(overscan);
     ShowFpsCounter->SetValue(showFps);
+    LimitMaxSpeedPresent->SetValue(limitMaxSpeedPresent);
+    EnableSoftwareRendering->SetValue(softwareRendering);
+    EnableVsync->SetValue(vsync);
+
+    int turboFrameSkip;
+    settings.Read("/Video/TurboFrameSkip", &turboFrameSkip);
+
+    TurboFrameSkip = new wxSpinCtrl(SettingsPanel, ID_TURBO_FRAME_SKIP, "", wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 0, 60, turboFrameSkip);
 
     wxStaticBoxSizer* resSizer = new wxStaticBoxSizer(wxVERTICAL, SettingsPanel, "Resolution");
     resSizer->Add(ResolutionComboBox, wxSizerFlags().Expand().Border(wxALL, 5));
 
     wxStaticBoxSizer* otherSizer = new wxStaticBoxSizer(wxVERTICAL, SettingsPanel, "Other");
     otherSizer->Add(EnableNtscDecoding);
+    otherSizer->Add(EnableGpuPalette);
     otherSizer->Add(EnableOverscan);
     otherSizer->Add(ShowFpsCounter);
+    otherSizer->Add(LimitMaxSpeedPresent);
+    otherSizer->Add(EnableSoftwareRendering);
+    otherSizer->Add(EnableVsync);
+
+    wxBoxSizer* turboSizer = new wxBoxSizer(wxHORIZONTAL);
+    turboSizer->Add(new wxStaticText(SettingsPanel, wxID_ANY, "Turbo Frame Skip"), wxSizerFlags().Align(wxALIGN_CENTER_VERTICAL).Border(wxRIGHT, 5));
+    turboSizer->Add(TurboFrameSkip);
+    otherSizer->Add(turboSizer, wxSizerFlags().Border(wxTOP, 5));
 
     wxBoxSizer* settingsSizer = new wxBoxSizer(wxVERTICAL);
     settingsSizer->Add(resSizer, wxSizerFlags().Expand().Border(wxALL, 5));
@@ -70,8 +98,11 @@ void VideoSettingsWindow::BindEvents()
 {
     Bind(wxEVT_COMBOBOX, &VideoSettingsWindow::ResolutionChanged, this, ID_RESOLUTION_CHANGED);
     Bind(wxEVT_CHECKBOX, &VideoSettingsWindow::EnableNtscDecodingClicked, this, ID_NTSC_ENABLED);
+    Bind(wxEVT_CHECKBOX, &VideoSettingsWindow::EnableGpuPaletteClicked, this, ID_GPU_PALETTE_ENABLED);
     Bind(wxEVT_CHECKBOX, &VideoSettingsWindow::EnableOverscanClicked, this, ID_OVERSCAN_ENABLED);
     Bind(wxEVT_CHECKBOX, &VideoSettingsWindow::ShowFpsCounterClicked, this, ID_SHOW_FPS_COUNTER);
+    Bind(wxEVT_SPINCTRL, &VideoSettingsWindow::TurboFrameSkipChanged, this, ID_TURBO_FRAME_SKIP);
+    Bind(wxEVT_CHECKBOX, &VideoSettingsWindow::LimitMaxSpeedPresentClicked, this, ID_LIMIT_MAX_SPEED_PRESENT);
 }
 
 void VideoSettingsWindow::DoClose()
@@ -87,11 +118,19 @@ void VideoSettingsWindow::DoOk()
 
     settings.Write("/Video/Resolution", ResolutionComboBox->GetSelection());
     settings.Write("/Video/NtscDecoding", EnableNtscDecoding->GetValue());
+    settings.Write("/Video/GpuPalette", EnableGpuPalette->GetValue());
     settings.Write("/Video/Overscan", EnableOverscan->GetValue());
     settings.Write("/Video/ShowFps", ShowFpsCounter->GetValue());
+    settings.Write("/Video/TurboFrameSkip", TurboFrameSkip->GetValue());
+    settings.Write("/Video/LimitMaxSpeedPresent", LimitMaxSpeedPresent->GetValue());
+    settings.Write("/Video/SoftwareRendering", EnableSoftwareRendering->GetValue());
+    settings.Write("/Video/Vsync", EnableVsync->GetValue());
 
     UpdateNtscDecoding(EnableNtscDecoding->GetValue());
+    UpdateGpuPalette(EnableGpuPalette->GetValue());
     UpdateShowFpsCounter(ShowFpsCounter->GetValue());
+    UpdateTurboFrameSkip(TurboFrameSkip->GetValue());
+    UpdateLimitMaxSpeedPresent(LimitMaxSpeedPresent->GetValue());
     UpdateGameResolution(ResolutionComboBox->GetSelection(), EnableOverscan->GetValue());
 
     Close();
@@ -101,16 +140,28 @@ void VideoSettingsWindow::DoCancel()
 {
     AppSettings& settings = AppSettings::GetInstance();
 
-    int resolution;
-    bool overscan, ntscDecoding, showFps;
+    int resolution, turboFrameSkip;
+    bool overscan, ntscDecoding, gpuPalette, showFps, limitMaxSpeedPresent, softwareRendering, vsync;
 
     settings.Read("/Video/Resolution", &resolution);
     settings.Read("/Video/NtscDecoding", &ntscDecoding);
+    settings.Read("/Video/GpuPalette", &gpuPalette);
     settings.Read("/Video/Overscan", &overscan);
     settings.Read("/Video/ShowFps", &showFps);
+    settings.Read("/Video/TurboFrameSkip", &turboFrameSkip);
+    settings.Read("/Video/LimitMaxSpeedPresent", &limitMaxSpeedPresent);
+    settings.Read("/Video/SoftwareRendering", &softwareRendering);
+    settings.Read("/Video/Vsync", &vsync);
+
+    // Only read when a game starts so there's nothing to update, just put the boxes back
+    EnableSoftwareRendering->SetValue(softwareRendering);
+    EnableVsync->SetValue(vsync);
 
     UpdateNtscDecoding(ntscDecoding);
+    UpdateGpuPalette(gpuPalette);
     UpdateShowFpsCounter(showFps);
+    UpdateTurboFrameSkip(turboFrameSkip);
+    UpdateLimitMaxSpeedPresent(limitMaxSpeedPresent);
     UpdateGameResolution(resolution, overscan);
 
     Close();
@@ -126,6 +177,11 @@ void VideoSettingsWindow::EnableNtscDecodingClicked(wxCommandEvent& WXUNUSED(eve
     UpdateNtscDecoding(EnableNtscDecoding->GetValue());
 }
 
+void VideoSettingsWindow::EnableGpuPaletteClicked(wxCommandEvent& WXUNUSED(event))
+{
+    UpdateGpuPalette(EnableGpuPalette->GetValue());
+}
+
 void VideoSettingsWindow::EnableOverscanClicked(wxCommandEvent& WXUNUSED(event))
 {
     UpdateGameResolution(ResolutionComboBox->GetSelection(), EnableOverscan->GetValue());
@@ -136,6 +192,16 @@ void VideoSettingsWindow::ShowFpsCounterClicked(wxCommandEvent& WXUNUSED(event))
     UpdateShowFpsCounter(ShowFpsCounter->GetValue());
 }
 
+void VideoSettingsWindow::TurboFrameSkipChanged(wxSpinEvent& WXUNUSED(event))
+{
+    UpdateTurboFrameSkip(TurboFrameSkip->GetValue());
+}
+
+void VideoSettingsWindow::LimitMaxSpeedPresentClicked(wxCommandEvent& WXUNUSED(event))
+{
+    UpdateLimitMaxSpeedPresent(LimitMaxSpeedPresent->GetValue());
+}
+
 void VideoSettingsWindow::UpdateGameResolution(int resIndex, bool overscan)
 {
     if (MainWindow* parent = dynamic_cast<MainWindow*>(GetParent()))
@@ -153,6 +219,14 @@ void VideoSettingsWindow::UpdateNtscDecoding(bool enabled)
     }
 }
 
+void VideoSettingsWindow::UpdateGpuPalette(bool enabled)
+{
+    if (Nes != nullptr)
+    {
+        Nes->SetGpuPaletteEnabled(enabled);
+    }
+}
+
 void VideoSettingsWindow::UpdateShowFpsCounter(bool enabled)
 {
     if (Nes != nullptr)
@@ -160,3 +234,19 @@ void VideoSettingsWindow::UpdateShowFpsCounter(bool enabled)
         Nes->SetFpsDisplayEnabled(enabled);
     }
 }
+
+void VideoSettingsWindow::UpdateTurboFrameSkip(int frames)
+{
+    if (Nes != nullptr)
+    {
+        Nes->SetTurboFrameSkip(frames);
+    }
+}
+
+void VideoSettingsWindow::UpdateLimitMaxSpeedPresent(bool enabled)
+{
+    if (Nes != nullptr)
+    {
+        Nes->SetMaxSpeedPresentRate(enabled ? 60 : 0);
+    }
+}
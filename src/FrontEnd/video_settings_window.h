@@ -5,6 +5,8 @@
 class MainWindow;
 class wxComboBox;
 class wxCheckBox;
+class wxSpinCtrl;
+class wxSpinEvent;
 
 wxDECLARE_EVENT(EVT_VIDEO_WINDOW_CLOSED, wxCommandEvent);
 
@@ -24,20 +26,36 @@ private:
 
     void ResolutionChanged(wxCommandEvent& event);
     void EnableNtscDecodingClicked(wxCommandEvent& event);
+    void EnableGpuPaletteClicked(wxCommandEvent& event);
     void EnableOverscanClicked(wxCommandEvent& event);
     void ShowFpsCounterClicked(wxCommandEvent& event);
+    void TurboFrameSkipChanged(wxSpinEvent& event);
+    void LimitMaxSpeedPresentClicked(wxCommandEvent& event);
 
     void UpdateGameResolution(int resIndex, bool overscan);
     void UpdateNtscDecoding(bool enabled);
+    void UpdateGpuPalette(bool enabled);
     void UpdateShowFpsCounter(bool enabled);
+    void UpdateTurboFrameSkip(int frames);
+    void UpdateLimitMaxSpeedPresent(bool enabled);
 
     wxComboBox* ResolutionComboBox;
     wxCheckBox* EnableNtscDecoding;
+    wxCheckBox* EnableGpuPalette;
     wxCheckBox* EnableOverscan;
     wxCheckBox* ShowFpsCounter;
+    wxSpinCtrl* TurboFrameSkip;
+    wxCheckBox* LimitMaxSpeedPresent;
+    wxCheckBox* EnableSoftwareRendering;
+    wxCheckBox* EnableVsync;
 };
 
 const int ID_RESOLUTION_CHANGED = 300;
 const int ID_NTSC_ENABLED = 301;
 const int ID_OVERSCAN_ENABLED = 302;
 const int ID_SHOW_FPS_COUNTER = 303;
+const int ID_TURBO_FRAME_SKIP = 304;
+const int ID_LIMIT_MAX_SPEED_PRESENT = 305;
+const int ID_GPU_PALETTE_ENABLED = 306;
+const int ID_SOFTWARE_RENDERING_ENABLED = 307;
+const int ID_VSYNC_ENABLED = 308;
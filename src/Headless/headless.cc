@@ -0,0 +1,160 @@
+/*
+ * headless.cc
+ *
+ * Runs a game with no window and no sound for a fixed number of frames, rendering
+ * to an offscreen surface, then reads the last frame back. Meant for machines
+ * without a display, to check the renderer works and to time it.
+ *
+ * Usage: D-NES-Headless <rom> [frames]
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "nes.h"
+
+namespace
+{
+constexpr uint32_t SURFACE_WIDTH = 256;
+constexpr uint32_t SURFACE_HEIGHT = 240;
+constexpr int DEFAULT_FRAMES = 600;
+
+class FrameCounter : public NESCallback
+{
+public:
+    FrameCounter(int target)
+        : Target(target)
+        , Frames(0)
+        , Failed(false)
+    {
+    }
+
+    void OnFrameComplete() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            ++Frames;
+        }
+
+        Cv.notify_one();
+    }
+
+    void OnError(std::exception_ptr eptr) override
+    {
+        try
+        {
+            std::rethrow_exception(eptr);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "Emulator error: " << e.what() << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Failed = true;
+        }
+
+        Cv.notify_one();
+    }
+
+    // Returns false if the emulator stopped with an error first
+    bool Wait()
+    {
+        std::unique_lock<std::mutex> lock(Mutex);
+        Cv.wait(lock, [this]() { return Failed || Frames >= Target; });
+
+        return !Failed;
+    }
+
+private:
+    int Target;
+    int Frames;
+    bool Failed;
+    std::mutex Mutex;
+    std::condition_variable Cv;
+};
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <rom> [frames]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int frames = argc > 2 ? std::atoi(argv[2]) : DEFAULT_FRAMES;
+    if (frames <= 0)
+    {
+        std::cerr << "Frame count must be positive" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    FrameCounter counter(frames);
+
+    try
+    {
+        NES nes(argv[1], "", nullptr, &counter, AudioOutput::Null, "", SURFACE_WIDTH, SURFACE_HEIGHT);
+
+        // Nothing to keep in time with, draw every frame as fast as they come
+        nes.SetAudioEnabled(false);
+        nes.SetMaxSpeedModeEnabled(true);
+        nes.SetMaxSpeedPresentRate(0);
+
+        auto start = std::chrono::steady_clock::now();
+        nes.Start();
+
+        bool finished = counter.Wait();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<uint32_t> pixels;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        bool read = finished && nes.ReadPresentedFrame(pixels, &width, &height);
+
+        nes.Stop();
+
+        if (!finished)
+        {
+            return EXIT_FAILURE;
+        }
+
+        if (!read)
+        {
+            std::cerr << "No frame could be read back from the offscreen surface" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (width != SURFACE_WIDTH || height != SURFACE_HEIGHT)
+        {
+            std::cerr << "Read back a " << width << "x" << height << " frame, expected "
+                      << SURFACE_WIDTH << "x" << SURFACE_HEIGHT << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // FNV-1a, so runs can be compared against each other
+        uint64_t checksum = 14695981039346656037ULL;
+        for (uint32_t pixel : pixels)
+        {
+            checksum = (checksum ^ pixel) * 1099511628211ULL;
+        }
+
+        std::cout << frames << " frames in " << seconds << " s (" << frames / seconds << " fps)" << std::endl;
+        std::cout << "Frame checksum: " << std::hex << checksum << std::endl;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file